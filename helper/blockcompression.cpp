@@ -0,0 +1,249 @@
+#include "blockcompression.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+namespace {
+    // BC7 interpolation weights for 4 bit indices, out of 64
+    const int BC7_WEIGHTS4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+    // Writes fields into a block from the least significant bit up
+    struct BitWriter {
+        unsigned char * out;
+        int pos;
+
+        void write(uint32_t value, int bits) {
+            for( int i = 0; i < bits; i++, pos++ ) {
+                if( value & (1u << i) ) out[pos >> 3] |= (unsigned char)(1u << (pos & 7));
+            }
+        }
+    };
+
+    // Copy the 4x4 block at (bx, by), clamping at the image edge
+    void fetchBlock(const unsigned char * rgba, int width, int height, int bx, int by, unsigned char block[16][4]) {
+        for( int y = 0; y < 4; y++ ) {
+            int sy = std::min(by * 4 + y, height - 1);
+            for( int x = 0; x < 4; x++ ) {
+                int sx = std::min(bx * 4 + x, width - 1);
+                memcpy(block[y * 4 + x], &rgba[((size_t)sy * width + sx) * 4], 4);
+            }
+        }
+    }
+
+    // BC4: two 8 bit endpoints and a 3 bit index per texel
+    void encodeBC4(const unsigned char block[16][4], int channel, unsigned char * out) {
+        int lo = 255, hi = 0;
+        for( int i = 0; i < 16; i++ ) {
+            lo = std::min(lo, (int)block[i][channel]);
+            hi = std::max(hi, (int)block[i][channel]);
+        }
+
+        memset(out, 0, 8);
+        out[0] = (unsigned char)hi;
+        out[1] = (unsigned char)lo;
+        if( hi == lo ) return;   // Every index 0
+
+        // With endpoint 0 > endpoint 1 the palette is both endpoints and six evenly spaced values
+        int palette[8];
+        palette[0] = hi;
+        palette[1] = lo;
+        for( int i = 2; i < 8; i++ ) palette[i] = ((8 - i) * hi + (i - 1) * lo) / 7;
+
+        BitWriter bits = { out + 2, 0 };
+        for( int i = 0; i < 16; i++ ) {
+            int v = block[i][channel];
+            int best = 0, bestErr = 256;
+            for( int p = 0; p < 8; p++ ) {
+                int err = std::abs(v - palette[p]);
+                if( err < bestErr ) { bestErr = err; best = p; }
+            }
+            bits.write(best, 3);
+        }
+    }
+
+    struct Endpoint {
+        int c7[4];   // 7 bit RGBA
+        int p;       // Shared low bit
+        int value(int ch) const { return (c7[ch] << 1) | p; }
+    };
+
+    // Nearest mode 6 endpoint to a float colour, trying both values of the p-bit
+    Endpoint quantizeEndpoint(const float c[4]) {
+        Endpoint best = {};
+        float bestErr = 1e30f;
+        for( int p = 0; p < 2; p++ ) {
+            Endpoint e;
+            e.p = p;
+            float err = 0.0f;
+            for( int ch = 0; ch < 4; ch++ ) {
+                e.c7[ch] = std::min(std::max((int)std::lround((c[ch] - p) * 0.5f), 0), 127);
+                float d = c[ch] - e.value(ch);
+                err += d * d;
+            }
+            if( err < bestErr ) { bestErr = err; best = e; }
+        }
+        return best;
+    }
+
+    // Choose the nearest palette entry for each texel, returning the total squared error
+    int selectIndices(const unsigned char block[16][4], const Endpoint & e0, const Endpoint & e1, int indices[16]) {
+        int palette[16][4];
+        for( int i = 0; i < 16; i++ ) {
+            int w = BC7_WEIGHTS4[i];
+            for( int ch = 0; ch < 4; ch++ ) {
+                palette[i][ch] = ((64 - w) * e0.value(ch) + w * e1.value(ch) + 32) >> 6;
+            }
+        }
+
+        int total = 0;
+        for( int t = 0; t < 16; t++ ) {
+            int best = 0, bestErr = INT32_MAX;
+            for( int i = 0; i < 16; i++ ) {
+                int err = 0;
+                for( int ch = 0; ch < 4; ch++ ) {
+                    int d = block[t][ch] - palette[i][ch];
+                    err += d * d;
+                }
+                if( err < bestErr ) { bestErr = err; best = i; }
+            }
+            indices[t] = best;
+            total += bestErr;
+        }
+        return total;
+    }
+
+    // BC7 mode 6: one subset, 7.7.7.7 endpoints with a p-bit each, 4 bit indices.
+    // Endpoints start from the block's principal axis and are then refit by least squares.
+    void encodeBC7(const unsigned char block[16][4], unsigned char * out) {
+        float mean[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+        for( int t = 0; t < 16; t++ ) {
+            for( int ch = 0; ch < 4; ch++ ) mean[ch] += block[t][ch] / 16.0f;
+        }
+
+        float cov[4][4] = {};
+        for( int t = 0; t < 16; t++ ) {
+            float d[4];
+            for( int ch = 0; ch < 4; ch++ ) d[ch] = block[t][ch] - mean[ch];
+            for( int i = 0; i < 4; i++ ) {
+                for( int j = 0; j < 4; j++ ) cov[i][j] += d[i] * d[j];
+            }
+        }
+
+        // Power iteration for the principal axis
+        float axis[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+        for( int iter = 0; iter < 8; iter++ ) {
+            float next[4] = {};
+            for( int i = 0; i < 4; i++ ) {
+                for( int j = 0; j < 4; j++ ) next[i] += cov[i][j] * axis[j];
+            }
+            float len = std::sqrt(next[0]*next[0] + next[1]*next[1] + next[2]*next[2] + next[3]*next[3]);
+            if( len < 1e-6f ) break;
+            for( int i = 0; i < 4; i++ ) axis[i] = next[i] / len;
+        }
+
+        float tMin = 1e30f, tMax = -1e30f;
+        for( int t = 0; t < 16; t++ ) {
+            float proj = 0.0f;
+            for( int ch = 0; ch < 4; ch++ ) proj += (block[t][ch] - mean[ch]) * axis[ch];
+            tMin = std::min(tMin, proj);
+            tMax = std::max(tMax, proj);
+        }
+
+        float c0[4], c1[4];
+        for( int ch = 0; ch < 4; ch++ ) {
+            c0[ch] = mean[ch] + axis[ch] * tMin;
+            c1[ch] = mean[ch] + axis[ch] * tMax;
+        }
+
+        Endpoint e0 = quantizeEndpoint(c0), e1 = quantizeEndpoint(c1);
+        int indices[16];
+        int err = selectIndices(block, e0, e1, indices);
+
+        for( int iter = 0; iter < 2 && err > 0; iter++ ) {
+            // Solve for the endpoints that best fit the chosen weights
+            float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+            float ax[4] = {}, bx[4] = {};
+            for( int t = 0; t < 16; t++ ) {
+                float w = BC7_WEIGHTS4[indices[t]] / 64.0f;
+                aa += (1.0f - w) * (1.0f - w);
+                ab += (1.0f - w) * w;
+                bb += w * w;
+                for( int ch = 0; ch < 4; ch++ ) {
+                    ax[ch] += (1.0f - w) * block[t][ch];
+                    bx[ch] += w * block[t][ch];
+                }
+            }
+            float det = aa * bb - ab * ab;
+            if( std::fabs(det) < 1e-6f ) break;
+
+            for( int ch = 0; ch < 4; ch++ ) {
+                c0[ch] = (bb * ax[ch] - ab * bx[ch]) / det;
+                c1[ch] = (aa * bx[ch] - ab * ax[ch]) / det;
+            }
+
+            Endpoint n0 = quantizeEndpoint(c0), n1 = quantizeEndpoint(c1);
+            int newIndices[16];
+            int newErr = selectIndices(block, n0, n1, newIndices);
+            if( newErr >= err ) break;
+            e0 = n0;
+            e1 = n1;
+            err = newErr;
+            memcpy(indices, newIndices, sizeof(indices));
+        }
+
+        // The first texel's index is stored without its top bit, so it must be below 8
+        if( indices[0] & 8 ) {
+            std::swap(e0, e1);
+            for( int t = 0; t < 16; t++ ) indices[t] = 15 - indices[t];
+        }
+
+        memset(out, 0, 16);
+        BitWriter bits = { out, 0 };
+        bits.write(1u << 6, 7);    // Mode 6
+        for( int ch = 0; ch < 4; ch++ ) {
+            bits.write(e0.c7[ch], 7);
+            bits.write(e1.c7[ch], 7);
+        }
+        bits.write(e0.p, 1);
+        bits.write(e1.p, 1);
+        bits.write(indices[0], 3);
+        for( int t = 1; t < 16; t++ ) bits.write(indices[t], 4);
+    }
+}
+
+int BlockCompression::blockBytes(Format format) {
+    return (format == Format::BC4) ? 8 : 16;
+}
+
+size_t BlockCompression::imageBytes(Format format, int width, int height) {
+    return (size_t)((width + 3) / 4) * ((height + 3) / 4) * blockBytes(format);
+}
+
+std::vector<unsigned char> BlockCompression::encode(const unsigned char * rgba, int width, int height, Format format) {
+    int blocksX = (width + 3) / 4, blocksY = (height + 3) / 4;
+    int bytes = blockBytes(format);
+    std::vector<unsigned char> out((size_t)blocksX * blocksY * bytes);
+
+    unsigned char block[16][4];
+    unsigned char * dst = out.data();
+    for( int by = 0; by < blocksY; by++ ) {
+        for( int bx = 0; bx < blocksX; bx++, dst += bytes ) {
+            fetchBlock(rgba, width, height, bx, by, block);
+            switch( format ) {
+                case Format::BC4:
+                    encodeBC4(block, 0, dst);
+                    break;
+                case Format::BC5:
+                    encodeBC4(block, 0, dst);
+                    encodeBC4(block, 1, dst + 8);
+                    break;
+                case Format::BC7:
+                    encodeBC7(block, dst);
+                    break;
+            }
+        }
+    }
+    return out;
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+// CPU encoders for the block compressed formats used by cooked textures. Every format
+// stores 4x4 texel blocks; images that are not a multiple of 4 are padded by repeating
+// their last row and column.
+namespace BlockCompression {
+
+    enum class Format {
+        BC4,    // One channel (red), 8 bytes per block
+        BC5,    // Two channels (red, green), 16 bytes per block. Used for tangent space normals.
+        BC7     // RGBA, 16 bytes per block
+    };
+
+    // Bytes per 4x4 block
+    int blockBytes(Format format);
+
+    // Bytes needed for a width x height image
+    size_t imageBytes(Format format, int width, int height);
+
+    // Encode a tightly packed RGBA image. BC4 takes red, BC5 takes red and green.
+    std::vector<unsigned char> encode(const unsigned char * rgba, int width, int height, Format format);
+}
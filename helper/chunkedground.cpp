@@ -0,0 +1,165 @@
+#include "chunkedground.h"
+#include "geometrycache.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+using glm::vec2;
+using glm::vec3;
+using glm::mat4;
+
+namespace {
+    // A node is split while the camera is closer to it than SPLIT_DISTANCE times its size.
+    // Any value above 1 keeps neighbouring tiles within one level of each other, which is
+    // all the stitching handles.
+    const float SPLIT_DISTANCE = 2.0f;
+
+    float distanceToBox(const vec3 & p, const Aabb & box) {
+        vec3 closest = glm::clamp(p, box.min, box.max);
+        return glm::length(p - closest);
+    }
+}
+
+ChunkedGround::ChunkedGround(float worldSize, float minTileSize, int tileDivs, float height) :
+    worldSize(worldSize), minTileSize(minTileSize), height(height), tileDivs(tileDivs),
+    vao(0), indexBuf(0), cameraPos(0.0f)
+{
+    tileMesh = GeometryCache::plane(1.0f, 1.0f, tileDivs, tileDivs);
+
+    glGenVertexArrays(1, &vao);
+    glBindVertexArray(vao);
+
+    buildIndexVariants();
+
+    // Share the tile's vertex buffer, with our own element buffer of stitched variants
+    glBindVertexBuffer(0, tileMesh->getPositionBuffer(), 0, Plane::Layout::stride);
+    Plane::Layout::apply(0);
+
+    glBindVertexArray(0);
+}
+
+ChunkedGround::~ChunkedGround() {
+    if( indexBuf != 0 ) glDeleteBuffers(1, &indexBuf);
+    if( vao != 0 ) glDeleteVertexArrays(1, &vao);
+}
+
+void ChunkedGround::buildIndexVariants() {
+    int n = tileDivs;
+    std::vector<GLuint> el;
+
+    for( int mask = 0; mask < 16; mask++ ) {
+        // Odd vertices along a stitched edge are moved onto the previous even vertex,
+        // which lines the edge up with the coarser neighbour's vertices
+        auto index = [&](int i, int j) {
+            if( (mask & EdgeMinZ) && i == 0 && (j & 1) ) j--;
+            if( (mask & EdgeMaxZ) && i == n && (j & 1) ) j--;
+            if( (mask & EdgeMinX) && j == 0 && (i & 1) ) i--;
+            if( (mask & EdgeMaxX) && j == n && (i & 1) ) i--;
+            return (GLuint)(i * (n + 1) + j);
+        };
+        auto addTriangle = [&](GLuint a, GLuint b, GLuint c) {
+            if( a == b || b == c || a == c ) return;  // Collapsed by stitching
+            el.push_back(a);
+            el.push_back(b);
+            el.push_back(c);
+        };
+
+        variantFirst[mask] = (GLsizei)el.size();
+
+        // Same triangulation as Plane
+        for( int i = 0; i < n; i++ ) {
+            for( int j = 0; j < n; j++ ) {
+                addTriangle(index(i, j), index(i+1, j), index(i+1, j+1));
+                addTriangle(index(i, j), index(i+1, j+1), index(i, j+1));
+            }
+        }
+
+        variantCount[mask] = (GLsizei)el.size() - variantFirst[mask];
+    }
+
+    glGenBuffers(1, &indexBuf);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuf);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, el.size() * sizeof(GLuint), el.data(), GL_STATIC_DRAW);
+}
+
+Aabb ChunkedGround::bounds(const Node & node) const {
+    float half = 0.5f * node.size;
+    Aabb box;
+    box.min = vec3(node.centre.x - half, height, node.centre.y - half);
+    box.max = vec3(node.centre.x + half, height, node.centre.y + half);
+    return box;
+}
+
+bool ChunkedGround::shouldSplit(const Node & node) const {
+    if( 0.5f * node.size < minTileSize ) return false;
+    return distanceToBox(cameraPos, bounds(node)) < SPLIT_DISTANCE * node.size;
+}
+
+// Size of the tile covering pt, or 0 outside the ground
+float ChunkedGround::leafSizeAt(const vec2 & pt) const {
+    float half = 0.5f * worldSize;
+    if( std::fabs(pt.x) > half || std::fabs(pt.y) > half ) return 0.0f;
+
+    Node node = { vec2(0.0f), worldSize };
+    while( shouldSplit(node) ) {
+        float q = 0.25f * node.size;
+        node.centre.x += (pt.x < node.centre.x) ? -q : q;
+        node.centre.y += (pt.y < node.centre.y) ? -q : q;
+        node.size *= 0.5f;
+    }
+    return node.size;
+}
+
+int ChunkedGround::stitchMask(const Node & node) const {
+    // Sample just across the middle of each edge
+    float d = 0.5f * node.size + 0.5f * minTileSize;
+    int mask = 0;
+    if( leafSizeAt(node.centre + vec2(0.0f, -d)) > node.size ) mask |= EdgeMinZ;
+    if( leafSizeAt(node.centre + vec2( d, 0.0f)) > node.size ) mask |= EdgeMaxX;
+    if( leafSizeAt(node.centre + vec2(0.0f,  d)) > node.size ) mask |= EdgeMaxZ;
+    if( leafSizeAt(node.centre + vec2(-d, 0.0f)) > node.size ) mask |= EdgeMinX;
+    return mask;
+}
+
+void ChunkedGround::selectTiles(const Node & node, const Frustum & frustum) {
+    if( !frustum.intersects(bounds(node)) ) return;
+
+    if( shouldSplit(node) ) {
+        float q = 0.25f * node.size;
+        float childSize = 0.5f * node.size;
+        selectTiles({ node.centre + vec2(-q, -q), childSize }, frustum);
+        selectTiles({ node.centre + vec2( q, -q), childSize }, frustum);
+        selectTiles({ node.centre + vec2(-q,  q), childSize }, frustum);
+        selectTiles({ node.centre + vec2( q,  q), childSize }, frustum);
+        return;
+    }
+
+    tiles.push_back({ node, stitchMask(node) });
+}
+
+void ChunkedGround::update(const vec3 & cameraPos, const mat4 & viewProjection) {
+    this->cameraPos = cameraPos;
+    tiles.clear();
+    selectTiles({ vec2(0.0f), worldSize }, Frustum(viewProjection));
+}
+
+void ChunkedGround::render(const std::function<void(const mat4 &)> & setModel) const {
+    glBindVertexArray(vao);
+    for( const Tile & tile : tiles ) {
+        mat4 model = glm::translate(mat4(1.0f), vec3(tile.node.centre.x, height, tile.node.centre.y));
+        model = glm::scale(model, vec3(tile.node.size, 1.0f, tile.node.size));
+        setModel(model);
+
+        glDrawElements(GL_TRIANGLES, variantCount[tile.stitch], GL_UNSIGNED_INT,
+                       (void *)(variantFirst[tile.stitch] * sizeof(GLuint)));
+    }
+    glBindVertexArray(0);
+}
+
+size_t ChunkedGround::getNumTriangles() const {
+    size_t count = 0;
+    for( const Tile & tile : tiles ) count += variantCount[tile.stitch] / 3;
+    return count;
+}
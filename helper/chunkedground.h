@@ -0,0 +1,68 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include "plane.h"
+#include "frustum.h"
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+// Flat ground covering a large square, drawn as a quadtree of tiles. Tiles near the
+// camera are subdivided, distant ones are left large, and tiles outside the view frustum
+// are skipped, so the triangle count grows only with the log of the world size.
+//
+// Every tile draws the same tileDivs x tileDivs Plane grid, scaled and moved into place.
+// Where a tile meets a coarser neighbour, an index variant that skips the odd vertices
+// along that edge is used, so there are no T-junctions or cracks at the seam.
+class ChunkedGround
+{
+public:
+    // tileDivs must be even. Tiles are never split below minTileSize.
+    ChunkedGround(float worldSize, float minTileSize, int tileDivs = 16, float height = 0.0f);
+    ~ChunkedGround();
+
+    ChunkedGround(const ChunkedGround &) = delete;
+    ChunkedGround & operator=(const ChunkedGround &) = delete;
+
+    // Select this frame's tiles from the camera's world position and projection * view
+    void update(const glm::vec3 & cameraPos, const glm::mat4 & viewProjection);
+
+    // Draw the selected tiles. setModel is called with each tile's model matrix before its draw.
+    void render(const std::function<void(const glm::mat4 &)> & setModel) const;
+
+    size_t getNumTiles() const { return tiles.size(); }
+    size_t getNumTriangles() const;
+
+private:
+    // Bit per tile edge, set when the neighbour across it is coarser
+    enum Edge { EdgeMinZ = 1, EdgeMaxX = 2, EdgeMaxZ = 4, EdgeMinX = 8 };
+
+    struct Node {
+        glm::vec2 centre;   // x, z
+        float size;
+    };
+
+    struct Tile {
+        Node node;
+        int stitch;
+    };
+
+    float worldSize, minTileSize, height;
+    int tileDivs;
+
+    std::shared_ptr<const Plane> tileMesh;
+    GLuint vao, indexBuf;
+    GLsizei variantFirst[16], variantCount[16];
+
+    glm::vec3 cameraPos;
+    std::vector<Tile> tiles;
+
+    void buildIndexVariants();
+    bool shouldSplit(const Node & node) const;
+    float leafSizeAt(const glm::vec2 & pt) const;
+    void selectTiles(const Node & node, const Frustum & frustum);
+    int stitchMask(const Node & node) const;
+    Aabb bounds(const Node & node) const;
+};
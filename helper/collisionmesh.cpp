@@ -0,0 +1,139 @@
+#include "collisionmesh.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+using glm::vec3;
+
+namespace {
+    // Slab test against the bounds, so misses skip the triangle loop
+    bool rayHitsBox(const Aabb & box, const vec3 & origin, const vec3 & dir, float maxDist) {
+        float tMin = 0.0f, tMax = maxDist;
+        for( int a = 0; a < 3; a++ ) {
+            if( std::fabs(dir[a]) < 1e-12f ) {
+                if( origin[a] < box.min[a] || origin[a] > box.max[a] ) return false;
+                continue;
+            }
+            float inv = 1.0f / dir[a];
+            float t0 = (box.min[a] - origin[a]) * inv;
+            float t1 = (box.max[a] - origin[a]) * inv;
+            if( t0 > t1 ) std::swap(t0, t1);
+            tMin = std::max(tMin, t0);
+            tMax = std::min(tMax, t1);
+            if( tMin > tMax ) return false;
+        }
+        return true;
+    }
+
+    // Separating axis test of a triangle (relative to the box centre) against box half extents h
+    bool separatedOnAxis(const vec3 & axis, const vec3 & v0, const vec3 & v1, const vec3 & v2, const vec3 & h) {
+        float p0 = glm::dot(v0, axis), p1 = glm::dot(v1, axis), p2 = glm::dot(v2, axis);
+        float r = h.x * std::fabs(axis.x) + h.y * std::fabs(axis.y) + h.z * std::fabs(axis.z);
+        return std::min(p0, std::min(p1, p2)) > r || std::max(p0, std::max(p1, p2)) < -r;
+    }
+}
+
+CollisionMesh::CollisionMesh(const std::vector<vec3> & points, const std::vector<GLuint> & faces) :
+    nTris(faces.size() / 3)
+{
+    xs.reserve(points.size());
+    ys.reserve(points.size());
+    zs.reserve(points.size());
+    for( vec3 p : points ) {
+        xs.push_back(p.x);
+        ys.push_back(p.y);
+        zs.push_back(p.z);
+        bounds.add(p);
+    }
+
+    if( points.size() <= std::numeric_limits<uint16_t>::max() ) {
+        indices16.assign(faces.begin(), faces.begin() + nTris * 3);
+    } else {
+        indices32.assign(faces.begin(), faces.begin() + nTris * 3);
+    }
+}
+
+size_t CollisionMesh::memoryUsage() const {
+    return (xs.size() + ys.size() + zs.size()) * sizeof(float) +
+           indices16.size() * sizeof(uint16_t) + indices32.size() * sizeof(uint32_t);
+}
+
+bool CollisionMesh::raycast(const vec3 & origin, const vec3 & dir, float maxDist, float & hitDist) const {
+    if( !rayHitsBox(bounds, origin, dir, maxDist) ) return false;
+    return indices32.empty() ? raycast(indices16, origin, dir, maxDist, hitDist)
+                             : raycast(indices32, origin, dir, maxDist, hitDist);
+}
+
+bool CollisionMesh::overlaps(const Aabb & box) const {
+    if( box.min.x > bounds.max.x || box.max.x < bounds.min.x ||
+        box.min.y > bounds.max.y || box.max.y < bounds.min.y ||
+        box.min.z > bounds.max.z || box.max.z < bounds.min.z ) return false;
+    return indices32.empty() ? overlaps(indices16, box) : overlaps(indices32, box);
+}
+
+template<typename Index>
+bool CollisionMesh::raycast(const std::vector<Index> & indices, const vec3 & origin, const vec3 & dir, float maxDist, float & hitDist) const {
+    // Moller-Trumbore, keeping the closest hit
+    bool hit = false;
+    float closest = maxDist;
+    for( size_t i = 0; i < indices.size(); i += 3 ) {
+        vec3 p0 = vertex(indices[i]);
+        vec3 e1 = vertex(indices[i+1]) - p0;
+        vec3 e2 = vertex(indices[i+2]) - p0;
+
+        vec3 pv = glm::cross(dir, e2);
+        float det = glm::dot(e1, pv);
+        if( std::fabs(det) < 1e-12f ) continue;
+        float invDet = 1.0f / det;
+
+        vec3 tv = origin - p0;
+        float u = glm::dot(tv, pv) * invDet;
+        if( u < 0.0f || u > 1.0f ) continue;
+
+        vec3 qv = glm::cross(tv, e1);
+        float v = glm::dot(dir, qv) * invDet;
+        if( v < 0.0f || u + v > 1.0f ) continue;
+
+        float t = glm::dot(e2, qv) * invDet;
+        if( t >= 0.0f && t < closest ) {
+            closest = t;
+            hit = true;
+        }
+    }
+
+    if( hit ) hitDist = closest;
+    return hit;
+}
+
+template<typename Index>
+bool CollisionMesh::overlaps(const std::vector<Index> & indices, const Aabb & box) const {
+    vec3 c = 0.5f * (box.max + box.min);
+    vec3 h = 0.5f * (box.max - box.min);
+    const vec3 boxAxes[3] = { vec3(1.0f, 0.0f, 0.0f), vec3(0.0f, 1.0f, 0.0f), vec3(0.0f, 0.0f, 1.0f) };
+
+    for( size_t i = 0; i < indices.size(); i += 3 ) {
+        vec3 v0 = vertex(indices[i]) - c;
+        vec3 v1 = vertex(indices[i+1]) - c;
+        vec3 v2 = vertex(indices[i+2]) - c;
+        vec3 edges[3] = { v1 - v0, v2 - v1, v0 - v2 };
+
+        bool separated = false;
+
+        // Box face normals
+        for( int a = 0; a < 3 && !separated; a++ )
+            separated = separatedOnAxis(boxAxes[a], v0, v1, v2, h);
+
+        // Triangle normal
+        if( !separated )
+            separated = separatedOnAxis(glm::cross(edges[0], edges[1]), v0, v1, v2, h);
+
+        // Edge cross products
+        for( int e = 0; e < 3 && !separated; e++ )
+            for( int a = 0; a < 3 && !separated; a++ )
+                separated = separatedOnAxis(glm::cross(edges[e], boxAxes[a]), v0, v1, v2, h);
+
+        if( !separated ) return true;
+    }
+    return false;
+}
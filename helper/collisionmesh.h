@@ -0,0 +1,45 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include "aabb.h"
+
+#include <cstdint>
+#include <vector>
+
+// Compact CPU copy of a triangle mesh's geometry for ray and overlap queries.
+// Positions are kept as separate x, y and z arrays, and indices use 16 bits whenever
+// the vertex count allows. Normals and tex coords aren't kept. Instances are
+// immutable, so one copy can be shared between every user of the same mesh.
+class CollisionMesh
+{
+public:
+    // faces is three indices into points per triangle
+    CollisionMesh(const std::vector<glm::vec3> & points, const std::vector<GLuint> & faces);
+
+    // Closest hit along origin + t * dir for t in [0, maxDist]. Returns false on a miss.
+    bool raycast(const glm::vec3 & origin, const glm::vec3 & dir, float maxDist, float & hitDist) const;
+
+    // True if any triangle overlaps the box
+    bool overlaps(const Aabb & box) const;
+
+    const Aabb & getBounds() const { return bounds; }
+    size_t getNumTriangles() const { return nTris; }
+
+    // Bytes used by the vertex and index arrays
+    size_t memoryUsage() const;
+
+private:
+    std::vector<float> xs, ys, zs;
+    std::vector<uint16_t> indices16;
+    std::vector<uint32_t> indices32;
+    size_t nTris;
+    Aabb bounds;
+
+    glm::vec3 vertex(size_t i) const { return glm::vec3(xs[i], ys[i], zs[i]); }
+
+    template<typename Index>
+    bool raycast(const std::vector<Index> & indices, const glm::vec3 & origin, const glm::vec3 & dir, float maxDist, float & hitDist) const;
+    template<typename Index>
+    bool overlaps(const std::vector<Index> & indices, const Aabb & box) const;
+};
@@ -1,64 +0,0 @@
-#include "cube.h"
-#include <glad/glad.h>
-#include <cstdio>
-
-Cube::Cube( GLfloat side )
-{
-    GLfloat side2 = side / 2.0f;
-
-    std::vector<GLfloat> p = {
-        // Front
-       -side2, -side2, side2, side2, -side2, side2, side2,  side2, side2,  -side2,  side2, side2,
-       // Right
-        side2, -side2, side2, side2, -side2, -side2, side2,  side2, -side2, side2,  side2, side2,
-       // Back
-       -side2, -side2, -side2, -side2,  side2, -side2, side2,  side2, -side2, side2, -side2, -side2,
-       // Left
-       -side2, -side2, side2, -side2,  side2, side2, -side2,  side2, -side2, -side2, -side2, -side2,
-       // Bottom
-       -side2, -side2, side2, -side2, -side2, -side2, side2, -side2, -side2, side2, -side2, side2,
-       // Top
-       -side2,  side2, side2, side2,  side2, side2, side2,  side2, -side2, -side2,  side2, -side2
-    };
-
-    std::vector<GLfloat> n = {
-        // Front
-        0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f,
-        // Right
-        1.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f,
-        // Back
-        0.0f, 0.0f, -1.0f, 0.0f, 0.0f, -1.0f, 0.0f, 0.0f, -1.0f, 0.0f, 0.0f, -1.0f,
-        // Left
-        -1.0f, 0.0f, 0.0f, -1.0f, 0.0f, 0.0f, -1.0f, 0.0f, 0.0f, -1.0f, 0.0f, 0.0f,
-        // Bottom
-        0.0f, -1.0f, 0.0f, 0.0f, -1.0f, 0.0f, 0.0f, -1.0f, 0.0f, 0.0f, -1.0f, 0.0f,
-        // Top
-        0.0f, 1.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f, 0.0f
-    };
-
-    std::vector<GLfloat> tex = {
-        // Front
-        0.0f, 0.0f, 1.0f, 0.0f, 1.0f, 1.0f, 0.0f, 1.0f,
-        // Right
-        0.0f, 0.0f, 1.0f, 0.0f, 1.0f, 1.0f, 0.0f, 1.0f,
-        // Back
-        0.0f, 0.0f, 1.0f, 0.0f, 1.0f, 1.0f, 0.0f, 1.0f,
-        // Left
-        0.0f, 0.0f, 1.0f, 0.0f, 1.0f, 1.0f, 0.0f, 1.0f,
-        // Bottom
-        0.0f, 0.0f, 1.0f, 0.0f, 1.0f, 1.0f, 0.0f, 1.0f,
-        // Top
-        0.0f, 0.0f, 1.0f, 0.0f, 1.0f, 1.0f, 0.0f, 1.0f
-    };
-
-    std::vector<GLuint> el = {
-        0,1,2,0,2,3,
-        4,5,6,4,6,7,
-        8,9,10,8,10,11,
-        12,13,14,12,14,15,
-        16,17,18,16,18,19,
-        20,21,22,20,22,23
-    };
-
-    initBuffers(&el, &p, &n, &tex);
-}
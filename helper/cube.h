@@ -2,9 +2,16 @@
 
 #include "drawable.h"
 #include "trianglemesh.h"
+#include "primitives.h"
 
+// The vertices are baked at compile time for the given side length
+template<int Side = 1>
 class Cube : public TriangleMesh
 {
 public:
-    Cube(GLfloat size = 1.0f);
+    Cube() {
+        const auto & verts = Primitives::cubeVertices<Side>;
+        const auto & el = Primitives::cubeElements;
+        initBuffers<Primitives::CubeLayout>(el.data(), (GLsizei)el.size(), verts.data(), (GLsizei)verts.size());
+    }
 };
@@ -0,0 +1,84 @@
+#include "equirect.h"
+#include "threadpool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <future>
+
+namespace {
+    const float PI = 3.14159265358979f;
+
+    // Rows resampled by each job, small enough to keep every thread busy to the end
+    const int BAND_ROWS = 32;
+
+    // Direction through face position (s, t), each -1 to 1 with t running down the face,
+    // following the GL cube map face layout
+    void faceDirection(int face, float s, float t, float & x, float & y, float & z) {
+        switch( face ) {
+            case 0:  x =  1.0f; y = -t;    z = -s;    break;   // +X
+            case 1:  x = -1.0f; y = -t;    z =  s;    break;   // -X
+            case 2:  x =  s;    y =  1.0f; z =  t;    break;   // +Y
+            case 3:  x =  s;    y = -1.0f; z = -t;    break;   // -Y
+            case 4:  x =  s;    y = -t;    z =  1.0f; break;   // +Z
+            default: x = -s;    y = -t;    z = -1.0f; break;   // -Z
+        }
+    }
+
+    void resampleRows(const float * rgb, int width, int height, int face, int faceSize,
+                      int firstRow, int lastRow, float * out) {
+        for( int row = firstRow; row < lastRow; row++ ) {
+            float t = 2.0f * (row + 0.5f) / faceSize - 1.0f;
+            float * texel = out + (size_t)row * faceSize * 3;
+            for( int col = 0; col < faceSize; col++, texel += 3 ) {
+                float s = 2.0f * (col + 0.5f) / faceSize - 1.0f;
+                float x, y, z;
+                faceDirection(face, s, t, x, y, z);
+                float length = std::sqrt(x * x + y * y + z * z);
+
+                // Longitude across the image, from -Z at the centre, and latitude down it
+                float u = 0.5f + std::atan2(x, -z) / (2.0f * PI);
+                float v = std::acos(std::max(-1.0f, std::min(1.0f, y / length))) / PI;
+
+                float fx = u * width - 0.5f, fy = v * height - 0.5f;
+                float x0f = std::floor(fx), y0f = std::floor(fy);
+                float ax = fx - x0f, ay = fy - y0f;
+                int x0 = (int)x0f % width;
+                if( x0 < 0 ) x0 += width;
+                int x1 = (x0 + 1 == width) ? 0 : x0 + 1;
+                int y0 = std::max(0, std::min(height - 1, (int)y0f));
+                int y1 = std::max(0, std::min(height - 1, (int)y0f + 1));
+
+                const float * p00 = rgb + ((size_t)y0 * width + x0) * 3;
+                const float * p10 = rgb + ((size_t)y0 * width + x1) * 3;
+                const float * p01 = rgb + ((size_t)y1 * width + x0) * 3;
+                const float * p11 = rgb + ((size_t)y1 * width + x1) * 3;
+                for( int c = 0; c < 3; c++ ) {
+                    float top = p00[c] + (p10[c] - p00[c]) * ax;
+                    float bottom = p01[c] + (p11[c] - p01[c]) * ax;
+                    texel[c] = top + (bottom - top) * ay;
+                }
+            }
+        }
+    }
+}
+
+std::vector<std::vector<float>> Equirect::toCubeFaces(const float * rgb, int width, int height, int faceSize, bool parallel) {
+    std::vector<std::vector<float>> faces(6, std::vector<float>((size_t)faceSize * faceSize * 3));
+
+    std::vector<std::future<void>> jobs;
+    for( int face = 0; face < 6; face++ ) {
+        for( int row = 0; row < faceSize; row += BAND_ROWS ) {
+            int lastRow = std::min(faceSize, row + BAND_ROWS);
+            float * out = faces[face].data();
+            if( parallel ) {
+                jobs.push_back(ThreadPool::shared().submit([=]() {
+                    resampleRows(rgb, width, height, face, faceSize, row, lastRow, out);
+                }));
+            } else {
+                resampleRows(rgb, width, height, face, faceSize, row, lastRow, out);
+            }
+        }
+    }
+    for( std::future<void> & job : jobs ) job.get();
+    return faces;
+}
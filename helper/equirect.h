@@ -0,0 +1,16 @@
+#pragma once
+
+#include <vector>
+
+// Resampling of equirectangular (latitude/longitude) environment images, the form most
+// HDR skies are shipped in, into cube maps
+namespace Equirect {
+
+    // The six faces of a faceSize x faceSize cube map sampled from rgb, a width x height image
+    // of tightly packed RGB floats with its top row (straight up) first. Faces are in GL order
+    // (+X, -X, +Y, -Y, +Z, -Z), each with its top row first like the faces loaded from files,
+    // with the image's centre column facing -Z. Each texel is a bilinear sample at its centre
+    // direction, wrapping around horizontally. With parallel set, bands of rows are resampled
+    // on ThreadPool::shared(), which must not be done from one of its own jobs.
+    std::vector<std::vector<float>> toCubeFaces(const float * rgb, int width, int height, int faceSize, bool parallel);
+}
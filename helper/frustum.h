@@ -0,0 +1,37 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include "aabb.h"
+
+// View frustum as six planes, for culling bounding boxes
+class Frustum {
+
+public:
+    // Planes are extracted from a combined projection * view matrix, giving a world space frustum
+    explicit Frustum( const glm::mat4 & viewProjection ) {
+        glm::mat4 m = glm::transpose(viewProjection);
+        planes[0] = m[3] + m[0];   // Left
+        planes[1] = m[3] - m[0];   // Right
+        planes[2] = m[3] + m[1];   // Bottom
+        planes[3] = m[3] - m[1];   // Top
+        planes[4] = m[3] + m[2];   // Near
+        planes[5] = m[3] - m[2];   // Far
+    }
+
+    // False only when the box is entirely outside one of the planes. Boxes near the
+    // corners can pass without being visible, which is fine for culling.
+    bool intersects( const Aabb & box ) const {
+        for( const glm::vec4 & p : planes ) {
+            // The corner furthest along the plane normal
+            glm::vec3 corner(
+                p.x >= 0.0f ? box.max.x : box.min.x,
+                p.y >= 0.0f ? box.max.y : box.min.y,
+                p.z >= 0.0f ? box.max.z : box.min.z);
+            if( glm::dot(glm::vec3(p), corner) + p.w < 0.0f ) return false;
+        }
+        return true;
+    }
+
+private:
+    glm::vec4 planes[6];
+};
@@ -0,0 +1,82 @@
+#pragma once
+
+#include "plane.h"
+#include "torus.h"
+#include "teapot.h"
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <cstring>
+#include <map>
+#include <memory>
+#include <string>
+
+// Shares procedural meshes between everything that asks for the same generator and
+// parameters. Each mesh is built and uploaded once, and its GL buffers are freed when
+// the last handle is released. Creates GL objects, so only use it on the GL thread.
+//
+//     std::shared_ptr<const Torus> torus = GeometryCache::torus(0.7f, 0.3f, 50, 50);
+//     torus->render();
+class GeometryCache
+{
+public:
+    static std::shared_ptr<const Plane> plane(float xsize, float zsize, int xdivs, int zdivs, float smax = 1.0f, float tmax = 1.0f) {
+        return get<Plane>("Plane", xsize, zsize, xdivs, zdivs, smax, tmax);
+    }
+
+    static std::shared_ptr<const Torus> torus(GLfloat outerRadius, GLfloat innerRadius, GLuint nsides, GLuint nrings) {
+        return get<Torus>("Torus", outerRadius, innerRadius, nsides, nrings);
+    }
+
+    static std::shared_ptr<const Teapot> teapot(int grid, const glm::mat4 & lidTransform) {
+        return get<Teapot>("Teapot", grid, lidTransform);
+    }
+
+    // Number of meshes currently alive in the cache
+    static size_t size() {
+        purge();
+        return entries().size();
+    }
+
+private:
+    // Keys are the generator name followed by the raw bytes of its parameters, so
+    // parameters only match when they are bit-for-bit equal
+    template<typename... Args>
+    static std::string makeKey(const char * type, const Args &... args) {
+        std::string key(type);
+        key.push_back('\0');
+        (key.append(reinterpret_cast<const char *>(&args), sizeof(args)), ...);
+        return key;
+    }
+
+    template<typename Mesh, typename... Args>
+    static std::shared_ptr<const Mesh> get(const char * type, const Args &... args) {
+        std::string key = makeKey(type, args...);
+
+        // Entries only hold weak references, so the cache never keeps a mesh alive by itself
+        auto it = entries().find(key);
+        if( it != entries().end() ) {
+            if( std::shared_ptr<const TriangleMesh> mesh = it->second.lock() ) {
+                return std::static_pointer_cast<const Mesh>(mesh);
+            }
+        }
+
+        purge();
+        std::shared_ptr<const Mesh> mesh = std::make_shared<const Mesh>(args...);
+        entries()[key] = mesh;
+        return mesh;
+    }
+
+    static void purge() {
+        for( auto it = entries().begin(); it != entries().end(); ) {
+            if( it->second.expired() ) it = entries().erase(it);
+            else ++it;
+        }
+    }
+
+    static std::map<std::string, std::weak_ptr<const TriangleMesh>> & entries() {
+        static std::map<std::string, std::weak_ptr<const TriangleMesh>> cache;
+        return cache;
+    }
+};
@@ -0,0 +1,94 @@
+#include "hdrencode.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <glm/gtc/packing.hpp>
+
+namespace {
+    // Shared exponent layout, from EXT_texture_shared_exponent
+    const int MANTISSA_BITS = 9;
+    const int EXPONENT_BIAS = 15;
+    const int MAX_EXPONENT = 31;
+
+    float clampComponent(float v, float maxValue) {
+        if( !(v > 0.0f) ) return 0.0f;   // Also NaN
+        return std::min(v, maxValue);
+    }
+}
+
+void HdrEncode::Error::add(const float * source, const float * decoded) {
+    float brightest = std::max(source[0], std::max(source[1], source[2]));
+    if( !(brightest > 0.0f) ) brightest = 1.0f;   // Black (or negative) source, so compare absolutely
+    for( int c = 0; c < 3; c++ ) {
+        double e = std::fabs((double)decoded[c] - source[c]) / brightest;
+        sum += e;
+        max = std::max(max, e);
+    }
+    count += 3;
+}
+
+void HdrEncode::Error::merge(const Error & other) {
+    sum += other.sum;
+    max = std::max(max, other.max);
+    count += other.count;
+}
+
+uint32_t HdrEncode::packRgb9e5(const float * rgb) {
+    float r = clampComponent(rgb[0], RGB9E5_MAX);
+    float g = clampComponent(rgb[1], RGB9E5_MAX);
+    float b = clampComponent(rgb[2], RGB9E5_MAX);
+    float brightest = std::max(r, std::max(g, b));
+
+    // Smallest exponent that holds the brightest component, bumped if rounding overflows it
+    int exponent = std::max(-EXPONENT_BIAS - 1, (int)std::floor(std::log2(std::max(brightest, 1e-30f)))) + 1 + EXPONENT_BIAS;
+    double scale = std::ldexp(1.0, exponent - EXPONENT_BIAS - MANTISSA_BITS);
+    if( (int)std::floor(brightest / scale + 0.5) == (1 << MANTISSA_BITS) ) {
+        exponent++;
+        scale *= 2.0;
+    }
+    exponent = std::min(exponent, MAX_EXPONENT);
+
+    uint32_t mr = (uint32_t)std::floor(r / scale + 0.5);
+    uint32_t mg = (uint32_t)std::floor(g / scale + 0.5);
+    uint32_t mb = (uint32_t)std::floor(b / scale + 0.5);
+    return mr | (mg << 9) | (mb << 18) | ((uint32_t)exponent << 27);
+}
+
+void HdrEncode::unpackRgb9e5(uint32_t packed, float * rgb) {
+    int exponent = (int)(packed >> 27);
+    float scale = (float)std::ldexp(1.0, exponent - EXPONENT_BIAS - MANTISSA_BITS);
+    rgb[0] = (packed & 0x1ff) * scale;
+    rgb[1] = ((packed >> 9) & 0x1ff) * scale;
+    rgb[2] = ((packed >> 18) & 0x1ff) * scale;
+}
+
+std::vector<unsigned char> HdrEncode::encodeRgb9e5(const float * rgb, size_t texels, Error & error) {
+    std::vector<unsigned char> out(texels * 4);
+    for( size_t i = 0; i < texels; i++ ) {
+        uint32_t packed = packRgb9e5(rgb + i * 3);
+        memcpy(&out[i * 4], &packed, 4);
+
+        float decoded[3];
+        unpackRgb9e5(packed, decoded);
+        error.add(rgb + i * 3, decoded);
+    }
+    return out;
+}
+
+std::vector<unsigned char> HdrEncode::encodeRgba16f(const float * rgb, size_t texels, Error & error) {
+    std::vector<unsigned char> out(texels * 8);
+    const uint16_t one = glm::packHalf1x16(1.0f);
+    for( size_t i = 0; i < texels; i++ ) {
+        uint16_t half[4];
+        float decoded[3];
+        for( int c = 0; c < 3; c++ ) {
+            half[c] = glm::packHalf1x16(clampComponent(rgb[i * 3 + c], HALF_MAX));
+            decoded[c] = glm::unpackHalf1x16(half[c]);
+        }
+        half[3] = one;
+        memcpy(&out[i * 8], half, 8);
+        error.add(rgb + i * 3, decoded);
+    }
+    return out;
+}
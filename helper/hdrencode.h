@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// CPU encoders for compact HDR texel formats, converting from 32-bit float RGB
+namespace HdrEncode {
+
+    // How far encoded texels are from their float source. Each component's error is
+    // relative to the brightest component of its texel, which is the precision both
+    // formats keep.
+    struct Error {
+        double sum = 0.0, max = 0.0;
+        size_t count = 0;
+
+        void add(const float * source, const float * decoded);
+        void merge(const Error & other);
+        double mean() const { return count > 0 ? sum / count : 0.0; }
+    };
+
+    // Largest value each format holds. Brighter texels are clamped.
+    const float RGB9E5_MAX = 65408.0f;
+    const float HALF_MAX = 65504.0f;
+
+    // GL_RGB9_E5: a 9 bit mantissa per channel and a shared 5 bit exponent in 4 bytes,
+    // laid out for GL_UNSIGNED_INT_5_9_9_9_REV. Negative values are clamped to 0.
+    uint32_t packRgb9e5(const float * rgb);
+    void unpackRgb9e5(uint32_t packed, float * rgb);
+
+    // Tightly packed RGB floats to RGB9_E5 texels, 4 bytes each
+    std::vector<unsigned char> encodeRgb9e5(const float * rgb, size_t texels, Error & error);
+
+    // Tightly packed RGB floats to RGBA half floats, 8 bytes each with alpha 1. Rows of
+    // any width stay 4 byte aligned, and drivers pad GL_RGB16F storage to this size anyway.
+    std::vector<unsigned char> encodeRgba16f(const float * rgb, size_t texels, Error & error);
+}
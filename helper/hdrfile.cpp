@@ -0,0 +1,294 @@
+#include "hdrfile.h"
+#include "mappedfile.h"
+#include "stb/stb_image.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define HDRFILE_SSE
+#include <emmintrin.h>
+#endif
+
+namespace {
+    // RGBE exponents that map straight onto RGB9_E5's 5 bit exponent, with the 8 bit
+    // mantissas doubled into 9 bits: m * 2^(e - 136) == 2m * 2^((e - 113) - 24)
+    const int RGB9E5_EXPONENT_OFFSET = 113;
+
+    bool readLine(const unsigned char *& p, const unsigned char * end, std::string & line) {
+        line.clear();
+        while( p < end && *p != '\n' ) line.push_back((char)*p++);
+        if( p == end ) return false;
+        p++;
+        return true;
+    }
+
+    // Same checks as stb: a Radiance signature, an RGBE format line, and the standard orientation
+    bool readHeader(const unsigned char *& p, const unsigned char * end, int & width, int & height) {
+        std::string line;
+        if( !readLine(p, end, line) || (line != "#?RADIANCE" && line != "#?RGBE") ) return false;
+
+        bool rgbe = false;
+        for( ;; ) {
+            if( !readLine(p, end, line) ) return false;
+            if( line.empty() ) break;
+            if( line == "FORMAT=32-bit_rle_rgbe" ) rgbe = true;
+        }
+        if( !rgbe || !readLine(p, end, line) ) return false;
+        return sscanf(line.c_str(), "-Y %d +X %d", &height, &width) == 2 && width > 0 && height > 0;
+    }
+
+    // Room after the last plane for the 16 byte stores that expand short runs
+    const size_t PLANE_SLACK = 16;
+
+    // Most runs are only a few bytes, so one 16 byte store beats memset and memcpy's size
+    // dispatch. Bytes past the run land in the slack or the next plane, which is written after.
+    inline void fillRun(unsigned char * dst, unsigned char value, int count) {
+#ifdef HDRFILE_SSE
+        if( count <= 16 ) {
+            _mm_storeu_si128((__m128i *)dst, _mm_set1_epi8((char)value));
+            return;
+        }
+#endif
+        memset(dst, value, count);
+    }
+
+    inline void copyRun(unsigned char * dst, const unsigned char * src, int count, const unsigned char * end) {
+#ifdef HDRFILE_SSE
+        if( count <= 16 && end - src >= 16 ) {
+            _mm_storeu_si128((__m128i *)dst, _mm_loadu_si128((const __m128i *)src));
+            return;
+        }
+#endif
+        memcpy(dst, src, count);
+    }
+
+    // Expand a run length encoded scanline into four planes of width bytes (R, G, B, E)
+    bool readRleScanline(const unsigned char *& p, const unsigned char * end, int width, unsigned char * planes) {
+        if( end - p < 4 || p[0] != 2 || p[1] != 2 || ((p[2] << 8) | p[3]) != width ) return false;
+        p += 4;
+
+        for( int c = 0; c < 4; c++ ) {
+            unsigned char * plane = planes + (size_t)c * width;
+            int x = 0;
+            while( x < width ) {
+                if( p == end ) return false;
+                int count = *p++;
+                if( count > 128 ) {
+                    count -= 128;
+                    if( count > width - x || p == end ) return false;
+                    fillRun(plane + x, *p++, count);
+                } else {
+                    if( count == 0 || count > width - x || end - p < count ) return false;
+                    copyRun(plane + x, p, count, end);
+                    p += count;
+                }
+                x += count;
+            }
+        }
+        return true;
+    }
+
+    // Uncompressed scanline of RGBE texels
+    bool readFlatScanline(const unsigned char *& p, const unsigned char * end, int width, unsigned char * planes) {
+        if( (size_t)(end - p) < (size_t)width * 4 ) return false;
+        for( int x = 0; x < width; x++ ) {
+            for( int c = 0; c < 4; c++ ) planes[(size_t)c * width + x] = p[x * 4 + c];
+        }
+        p += (size_t)width * 4;
+        return true;
+    }
+
+    // stb's conversion, which the vectorized paths must match
+    void texelToFloat(int r, int g, int b, int e, float * out) {
+        if( e != 0 ) {
+            float f = (float)ldexp(1.0f, e - 136);
+            out[0] = r * f;
+            out[1] = g * f;
+            out[2] = b * f;
+        } else {
+            out[0] = out[1] = out[2] = 0.0f;
+        }
+    }
+
+#ifdef HDRFILE_SSE
+    // Four bytes to four 32 bit lanes
+    inline __m128i widen(const unsigned char * p) {
+        const __m128i zero = _mm_setzero_si128();
+        int32_t v;
+        memcpy(&v, p, 4);
+        __m128i bytes = _mm_unpacklo_epi8(_mm_cvtsi32_si128(v), zero);
+        return _mm_unpacklo_epi16(bytes, zero);
+    }
+#endif
+
+    void rowToFloat(const unsigned char * planes, int width, float * out) {
+        const unsigned char * r = planes, * g = r + width, * b = g + width, * e = b + width;
+        int x = 0;
+#ifdef HDRFILE_SSE
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i nine = _mm_set1_epi32(9), ten = _mm_set1_epi32(10);
+
+        // The fourth store runs one float past the group, so stop while a texel still follows it
+        for( ; x + 4 < width; x += 4 ) {
+            __m128i exponent = widen(e + x);
+
+            // Exponents 1-9 give denormal scales, which the bits below can't build
+            __m128i denormal = _mm_and_si128(_mm_cmpgt_epi32(exponent, zero), _mm_cmplt_epi32(exponent, ten));
+            if( _mm_movemask_epi8(denormal) != 0 ) {
+                for( int i = x; i < x + 4; i++ ) texelToFloat(r[i], g[i], b[i], e[i], out + i * 3);
+                continue;
+            }
+
+            // 2^(e - 136) built directly as float bits, and 0 where e is 0
+            __m128 scale = _mm_castsi128_ps(_mm_slli_epi32(_mm_sub_epi32(exponent, nine), 23));
+            scale = _mm_andnot_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(exponent, zero)), scale);
+
+            __m128 vr = _mm_mul_ps(_mm_cvtepi32_ps(widen(r + x)), scale);
+            __m128 vg = _mm_mul_ps(_mm_cvtepi32_ps(widen(g + x)), scale);
+            __m128 vb = _mm_mul_ps(_mm_cvtepi32_ps(widen(b + x)), scale);
+            __m128 va = _mm_setzero_ps();
+            _MM_TRANSPOSE4_PS(vr, vg, vb, va);
+
+            // Each texel's spare lane is overwritten by the next texel's red
+            float * o = out + x * 3;
+            _mm_storeu_ps(o, vr);
+            _mm_storeu_ps(o + 3, vg);
+            _mm_storeu_ps(o + 6, vb);
+            _mm_storeu_ps(o + 9, va);
+        }
+#endif
+        for( ; x < width; x++ ) texelToFloat(r[x], g[x], b[x], e[x], out + x * 3);
+    }
+
+    // A texel whose exponent is outside RGB9_E5's range goes through float, picking the best exponent
+    uint32_t texelToRgb9e5(int r, int g, int b, int e, HdrEncode::Error * error) {
+        if( e == 0 ) {
+            if( error != nullptr ) error->count += 3;
+            return 0;
+        }
+        int exponent = e - RGB9E5_EXPONENT_OFFSET;
+        if( exponent >= 0 && exponent <= 31 ) {
+            if( error != nullptr ) error->count += 3;
+            return (uint32_t)(r << 1) | ((uint32_t)(g << 1) << 9) | ((uint32_t)(b << 1) << 18) | ((uint32_t)exponent << 27);
+        }
+
+        float rgb[3], decoded[3];
+        texelToFloat(r, g, b, e, rgb);
+        uint32_t packed = HdrEncode::packRgb9e5(rgb);
+        if( error != nullptr ) {
+            HdrEncode::unpackRgb9e5(packed, decoded);
+            error->add(rgb, decoded);
+        }
+        return packed;
+    }
+
+    void rowToRgb9e5(const unsigned char * planes, int width, uint32_t * out, HdrEncode::Error * error) {
+        const unsigned char * r = planes, * g = r + width, * b = g + width, * e = b + width;
+        int x = 0;
+#ifdef HDRFILE_SSE
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i offset = _mm_set1_epi32(RGB9E5_EXPONENT_OFFSET);
+        const __m128i below = _mm_set1_epi32(-1), above = _mm_set1_epi32(32);
+        size_t exact = 0;
+
+        for( ; x + 4 <= width; x += 4 ) {
+            __m128i exponent = widen(e + x);
+            __m128i black = _mm_cmpeq_epi32(exponent, zero);
+            __m128i shifted = _mm_sub_epi32(exponent, offset);
+            __m128i inRange = _mm_and_si128(_mm_cmpgt_epi32(shifted, below), _mm_cmplt_epi32(shifted, above));
+            if( _mm_movemask_epi8(_mm_or_si128(black, inRange)) != 0xffff ) {
+                for( int i = x; i < x + 4; i++ ) out[i] = texelToRgb9e5(r[i], g[i], b[i], e[i], error);
+                continue;
+            }
+
+            __m128i packed = _mm_slli_epi32(widen(r + x), 1);
+            packed = _mm_or_si128(packed, _mm_slli_epi32(widen(g + x), 10));
+            packed = _mm_or_si128(packed, _mm_slli_epi32(widen(b + x), 19));
+            packed = _mm_or_si128(packed, _mm_slli_epi32(shifted, 27));
+            packed = _mm_andnot_si128(black, packed);
+            _mm_storeu_si128((__m128i *)(out + x), packed);
+            exact += 4;
+        }
+        if( error != nullptr ) error->count += exact * 3;
+#endif
+        for( ; x < width; x++ ) out[x] = texelToRgb9e5(r[x], g[x], b[x], e[x], error);
+    }
+}
+
+bool HdrFile::load(const std::string & fName, Output output, int & width, int & height,
+                   std::vector<unsigned char> & texels, HdrEncode::Error * error) {
+    MappedFile file(fName);
+    if( !file.isOpen() ) return false;
+
+    const unsigned char * p = file.data();
+    const unsigned char * end = p + file.size();
+    if( !readHeader(p, end, width, height) ) return false;
+
+    // Like stb, images are flat unless their width allows run lengths and the first scanline has one
+    bool rle = width >= 8 && width < 32768 && end - p >= 3 && p[0] == 2 && p[1] == 2 && (p[2] & 0x80) == 0;
+
+    size_t texelBytes = (output == Output::RGB32F) ? 3 * sizeof(float) : sizeof(uint32_t);
+    size_t rowBytes = (size_t)width * texelBytes;
+    texels.resize(rowBytes * height);
+    std::vector<unsigned char> planes((size_t)width * 4 + PLANE_SLACK);
+
+    for( int y = 0; y < height; y++ ) {
+        bool read = rle ? readRleScanline(p, end, width, planes.data()) : readFlatScanline(p, end, width, planes.data());
+        if( !read ) return false;
+
+        unsigned char * row = texels.data() + rowBytes * y;
+        if( output == Output::RGB32F ) {
+            rowToFloat(planes.data(), width, (float *)row);
+        } else {
+            rowToRgb9e5(planes.data(), width, (uint32_t *)row, error);
+        }
+    }
+    return true;
+}
+
+void HdrFile::benchmark(const std::vector<std::string> & fileNames) {
+    const int RUNS = 3;
+    auto best = [](auto run) {
+        double fastest = 1e30;
+        for( int i = 0; i < RUNS; i++ ) {
+            auto start = std::chrono::steady_clock::now();
+            run();
+            fastest = std::min(fastest, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+        }
+        return fastest;
+    };
+
+    printf("HDR decode (best of %d): file, stbi_loadf ms, float ms, RGB9_E5 ms, float speedup, identical\n", RUNS);
+    for( const std::string & fName : fileNames ) {
+        int w = 0, h = 0, stbW = 0, stbH = 0;
+        float * stb = nullptr;
+        double stbMs = best([&]() {
+            stbi_image_free(stb);
+            stb = stbi_loadf(fName.c_str(), &stbW, &stbH, NULL, 3);
+        });
+        if( stb == nullptr ) {
+            printf("%s: unable to load\n", fName.c_str());
+            continue;
+        }
+
+        std::vector<unsigned char> texels;
+        bool loaded = true;
+        double floatMs = best([&]() { loaded &= load(fName, Output::RGB32F, w, h, texels); });
+        bool identical = loaded && w == stbW && h == stbH &&
+                         memcmp(texels.data(), stb, (size_t)w * h * 3 * sizeof(float)) == 0;
+        double rgb9e5Ms = best([&]() { loaded &= load(fName, Output::RGB9E5, w, h, texels); });
+        stbi_image_free(stb);
+
+        if( !loaded ) {
+            printf("%s: %.2f ms with stb, not readable without it\n", fName.c_str(), stbMs);
+            continue;
+        }
+        printf("%s %10.2f %10.2f %10.2f %7.2fx %s\n", fName.c_str(), stbMs, floatMs, rgb9e5Ms, stbMs / floatMs,
+               identical ? "yes" : "NO");
+    }
+}
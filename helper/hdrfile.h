@@ -0,0 +1,28 @@
+#pragma once
+
+#include "hdrencode.h"
+
+#include <string>
+#include <vector>
+
+// Reader for Radiance .hdr (RGBE) images. The file is memory mapped and its run length
+// encoded scanlines are expanded one channel at a time, mostly with single 16 byte stores,
+// then converted four texels at a time (with SSE2 where available) straight into the
+// caller's upload buffer. Rows are kept in file order, top first, as stbi_loadf gives them.
+namespace HdrFile {
+
+    enum class Output {
+        RGB32F,     // Tightly packed RGB floats, bit for bit what stbi_loadf gives
+        RGB9E5      // GL_RGB9_E5 texels. An RGBE texel fits exactly unless it is brighter than
+                    // 65280 or dimmer than 2^-16, when it is converted through float instead.
+    };
+
+    // Decode fName into texels, replacing their contents. With RGB9E5 output, error (if given)
+    // collects the conversion error against the float texels. Returns false if the file is
+    // missing or uses something only stb reads (old style run lengths, rotated or XYZE images).
+    bool load(const std::string & fName, Output output, int & width, int & height,
+              std::vector<unsigned char> & texels, HdrEncode::Error * error = nullptr);
+
+    // Times load() against stbi_loadf on each file and checks the float results are identical
+    void benchmark(const std::vector<std::string> & fileNames);
+}
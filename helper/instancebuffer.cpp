@@ -0,0 +1,38 @@
+#include "instancebuffer.h"
+
+#include <vector>
+
+InstanceBuffer::InstanceBuffer() : buffer(0), count(0), capacity(0)
+{ }
+
+InstanceBuffer::~InstanceBuffer() {
+    if( buffer != 0 ) {
+        glDeleteBuffers(1, &buffer);
+    }
+}
+
+void InstanceBuffer::update(const glm::mat4 * modelMatrices, GLsizei n) {
+    if( buffer == 0 ) glGenBuffers(1, &buffer);
+
+    // Normal matrices are computed once per instance here rather than once per draw
+    std::vector<InstanceData> data(n);
+    for( GLsizei i = 0; i < n; i++ ) {
+        data[i].modelMatrix = modelMatrices[i];
+        data[i].normalMatrix = glm::mat4(glm::transpose(glm::inverse(glm::mat3(modelMatrices[i]))));
+    }
+
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+    if( n > capacity ) {
+        // Grow the buffer, leaving room so that small changes in count don't reallocate
+        capacity = n * 2;
+        glBufferData(GL_SHADER_STORAGE_BUFFER, capacity * sizeof(InstanceData), nullptr, GL_DYNAMIC_DRAW);
+    }
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, n * sizeof(InstanceData), data.data());
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    count = n;
+}
+
+void InstanceBuffer::bind() const {
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, BINDING, buffer);
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+// Per-instance transforms stored in a shader storage buffer, read by pbr.vert
+// through gl_InstanceID when the Instanced uniform is set.
+class InstanceBuffer
+{
+public:
+    // Binding point of the InstanceBuffer block in pbr.vert
+    static const GLuint BINDING = 0;
+
+    // Layout of one entry in the buffer (std430)
+    struct InstanceData {
+        glm::mat4 modelMatrix;
+        glm::mat4 normalMatrix; // Inverse transpose of the upper 3x3 of modelMatrix, padded to a mat4
+    };
+
+    InstanceBuffer();
+    ~InstanceBuffer();
+
+    // Make it non-copyable.
+    InstanceBuffer(const InstanceBuffer &) = delete;
+    InstanceBuffer & operator=(const InstanceBuffer &) = delete;
+
+    // Upload the model matrices of count instances, replacing the previous contents
+    void update(const glm::mat4 * modelMatrices, GLsizei count);
+    void bind() const;
+
+    GLsizei getCount() const { return count; }
+
+private:
+    GLuint buffer;
+    GLsizei count;
+    GLsizei capacity;
+};
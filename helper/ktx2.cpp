@@ -0,0 +1,210 @@
+#include "ktx2.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+namespace {
+    const unsigned char IDENTIFIER[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+
+    // Data format descriptor values (Khronos Data Format spec)
+    const uint8_t KHR_DF_MODEL_RGBSDA = 1, KHR_DF_MODEL_BC4 = 131, KHR_DF_MODEL_BC5 = 132, KHR_DF_MODEL_BC7 = 134;
+    const uint8_t KHR_DF_PRIMARIES_BT709 = 1;
+    const uint8_t KHR_DF_TRANSFER_LINEAR = 1, KHR_DF_TRANSFER_SRGB = 2;
+    const uint8_t KHR_DF_CHANNEL_R = 0, KHR_DF_CHANNEL_G = 1, KHR_DF_CHANNEL_B = 2, KHR_DF_CHANNEL_A = 15;
+    const uint8_t KHR_DF_SAMPLE_FLOAT = 0x80, KHR_DF_SAMPLE_SIGNED = 0x40, KHR_DF_SAMPLE_EXPONENT = 0x20;
+    const uint32_t FLOAT_MINUS_ONE = 0xBF800000, FLOAT_ONE = 0x3F800000;
+
+    const char * ORIENTATION_KEY = "KTXorientation";
+    const char * ORIENTATION_2D = "ru";     // Rows run up the image
+    const char * ORIENTATION_CUBE = "rd";   // Rows run down each face
+
+    // The 64 bit fields sit at 4 byte offsets in the file
+    #pragma pack(push, 1)
+    struct Header {
+        uint32_t vkFormat, typeSize, pixelWidth, pixelHeight, pixelDepth;
+        uint32_t layerCount, faceCount, levelCount, supercompressionScheme;
+        uint32_t dfdByteOffset, dfdByteLength, kvdByteOffset, kvdByteLength;
+        uint64_t sgdByteOffset, sgdByteLength;
+    };
+    #pragma pack(pop)
+
+    struct LevelIndex {
+        uint64_t byteOffset, byteLength, uncompressedByteLength;
+    };
+
+    struct Sample {
+        int bitOffset, bitLength;
+        uint8_t channel;        // Channel type and qualifier bits
+        uint32_t lower, upper;
+    };
+
+    struct FormatInfo {
+        uint8_t model;
+        int blockSize;          // Texels along each side of a block, 1 for uncompressed formats
+        int blockBytes;
+        int typeSize;           // Size of the format's data type, for endian conversion
+        std::vector<Sample> samples;
+    };
+
+    bool formatInfo(uint32_t vkFormat, FormatInfo & info) {
+        const uint8_t rgb[3] = { KHR_DF_CHANNEL_R, KHR_DF_CHANNEL_G, KHR_DF_CHANNEL_B };
+        const uint8_t floatBits = KHR_DF_SAMPLE_FLOAT | KHR_DF_SAMPLE_SIGNED;
+        switch( vkFormat ) {
+            case Ktx2::VK_FORMAT_BC4_UNORM_BLOCK:
+                info = { KHR_DF_MODEL_BC4, 4, 8, 1, { { 0, 64, 0, 0, 0xFFFFFFFF } } };
+                return true;
+            case Ktx2::VK_FORMAT_BC5_UNORM_BLOCK:
+                info = { KHR_DF_MODEL_BC5, 4, 16, 1, { { 0, 64, 0, 0, 0xFFFFFFFF }, { 64, 64, 1, 0, 0xFFFFFFFF } } };
+                return true;
+            case Ktx2::VK_FORMAT_BC7_UNORM_BLOCK:
+            case Ktx2::VK_FORMAT_BC7_SRGB_BLOCK:
+                info = { KHR_DF_MODEL_BC7, 4, 16, 1, { { 0, 128, 0, 0, 0xFFFFFFFF } } };
+                return true;
+            case Ktx2::VK_FORMAT_R16G16B16A16_SFLOAT:
+                info = { KHR_DF_MODEL_RGBSDA, 1, 8, 2, {} };
+                for( int c = 0; c < 3; c++ ) info.samples.push_back({ c * 16, 16, (uint8_t)(rgb[c] | floatBits), FLOAT_MINUS_ONE, FLOAT_ONE });
+                info.samples.push_back({ 48, 16, (uint8_t)(KHR_DF_CHANNEL_A | floatBits), FLOAT_MINUS_ONE, FLOAT_ONE });
+                return true;
+            case Ktx2::VK_FORMAT_R32G32B32_SFLOAT:
+                info = { KHR_DF_MODEL_RGBSDA, 1, 12, 4, {} };
+                for( int c = 0; c < 3; c++ ) info.samples.push_back({ c * 32, 32, (uint8_t)(rgb[c] | floatBits), FLOAT_MINUS_ONE, FLOAT_ONE });
+                return true;
+            case Ktx2::VK_FORMAT_E5B9G9R9_UFLOAT_PACK32:
+                // Each channel's 9 bit mantissa, then the shared exponent (bias 15) qualifying it
+                info = { KHR_DF_MODEL_RGBSDA, 1, 4, 4, {} };
+                for( int c = 0; c < 3; c++ ) {
+                    info.samples.push_back({ c * 9, 9, rgb[c], 0, 256 });
+                    info.samples.push_back({ 27, 5, (uint8_t)(rgb[c] | KHR_DF_SAMPLE_EXPONENT), 15, 31 });
+                }
+                return true;
+        }
+        return false;
+    }
+
+    void append32(std::vector<unsigned char> & out, uint32_t v) {
+        for( int i = 0; i < 4; i++ ) out.push_back((unsigned char)(v >> (8 * i)));
+    }
+
+    // A basic descriptor block
+    std::vector<unsigned char> makeDfd(uint32_t vkFormat, const FormatInfo & info) {
+        uint32_t blockSize = 24 + 16 * (uint32_t)info.samples.size();
+        std::vector<unsigned char> dfd;
+        append32(dfd, 4 + blockSize);         // dfdTotalSize
+        append32(dfd, 0);                     // vendorId, descriptorType
+        append32(dfd, 2 | (blockSize << 16)); // versionNumber, descriptorBlockSize
+        dfd.push_back(info.model);
+        dfd.push_back(KHR_DF_PRIMARIES_BT709);
+        dfd.push_back(vkFormat == Ktx2::VK_FORMAT_BC7_SRGB_BLOCK ? KHR_DF_TRANSFER_SRGB : KHR_DF_TRANSFER_LINEAR);
+        dfd.push_back(0);                     // Straight alpha
+        const unsigned char blockDim = (unsigned char)(info.blockSize - 1);   // Each stored minus one
+        const unsigned char blockDims[4] = { blockDim, blockDim, 0, 0 };
+        dfd.insert(dfd.end(), blockDims, blockDims + 4);
+        dfd.push_back((unsigned char)info.blockBytes);
+        dfd.insert(dfd.end(), 7, 0);
+
+        for( const Sample & sample : info.samples ) {
+            append32(dfd, (uint32_t)sample.bitOffset | ((uint32_t)(sample.bitLength - 1) << 16) | ((uint32_t)sample.channel << 24));
+            append32(dfd, 0);                 // Sample position
+            append32(dfd, sample.lower);
+            append32(dfd, sample.upper);
+        }
+        return dfd;
+    }
+
+    std::vector<unsigned char> makeKvd(const char * orientation) {
+        size_t length = strlen(ORIENTATION_KEY) + 1 + strlen(orientation) + 1;
+        std::vector<unsigned char> kvd;
+        append32(kvd, (uint32_t)length);
+        kvd.insert(kvd.end(), ORIENTATION_KEY, ORIENTATION_KEY + strlen(ORIENTATION_KEY) + 1);
+        kvd.insert(kvd.end(), orientation, orientation + strlen(orientation) + 1);
+        while( kvd.size() % 4 != 0 ) kvd.push_back(0);
+        return kvd;
+    }
+
+    size_t alignUp(size_t v, size_t alignment) {
+        return (v + alignment - 1) / alignment * alignment;
+    }
+}
+
+bool Ktx2::write( const std::string & fName, const Image & image ) {
+    FormatInfo info;
+    if( !formatInfo(image.vkFormat, info) || image.levels.empty() || (image.faces != 1 && image.faces != 6) ) return false;
+
+    std::vector<unsigned char> dfd = makeDfd(image.vkFormat, info);
+    std::vector<unsigned char> kvd = makeKvd(image.faces == 6 ? ORIENTATION_CUBE : ORIENTATION_2D);
+    uint32_t levelCount = (uint32_t)image.levels.size();
+
+    Header header = {};
+    header.vkFormat = image.vkFormat;
+    header.typeSize = info.typeSize;
+    header.pixelWidth = image.width;
+    header.pixelHeight = image.height;
+    header.faceCount = image.faces;
+    header.levelCount = levelCount;
+    header.dfdByteOffset = (uint32_t)(sizeof(IDENTIFIER) + sizeof(Header) + levelCount * sizeof(LevelIndex));
+    header.dfdByteLength = (uint32_t)dfd.size();
+    header.kvdByteOffset = header.dfdByteOffset + header.dfdByteLength;
+    header.kvdByteLength = (uint32_t)kvd.size();
+
+    // Level data goes smallest first, each level aligned to the block size (always a multiple of 4 here)
+    std::vector<LevelIndex> index(levelCount);
+    size_t offset = header.kvdByteOffset + header.kvdByteLength;
+    for( int i = (int)levelCount - 1; i >= 0; i-- ) {
+        offset = alignUp(offset, info.blockBytes);
+        index[i].byteOffset = offset;
+        index[i].byteLength = image.levels[i].size();
+        index[i].uncompressedByteLength = image.levels[i].size();
+        offset += image.levels[i].size();
+    }
+
+    std::ofstream out(fName, std::ios::binary);
+    if( !out ) return false;
+
+    out.write((const char *)IDENTIFIER, sizeof(IDENTIFIER));
+    out.write((const char *)&header, sizeof(header));
+    out.write((const char *)index.data(), index.size() * sizeof(LevelIndex));
+    out.write((const char *)dfd.data(), dfd.size());
+    out.write((const char *)kvd.data(), kvd.size());
+    for( int i = (int)levelCount - 1; i >= 0; i-- ) {
+        while( (size_t)out.tellp() < index[i].byteOffset ) out.put(0);
+        out.write((const char *)image.levels[i].data(), image.levels[i].size());
+    }
+    return (bool)out;
+}
+
+bool Ktx2::read( const std::string & fName, Image & image, int firstLevel, int endLevel ) {
+    std::ifstream in(fName, std::ios::binary);
+    if( !in ) return false;
+
+    unsigned char identifier[12];
+    Header header;
+    in.read((char *)identifier, sizeof(identifier));
+    in.read((char *)&header, sizeof(header));
+    if( !in || memcmp(identifier, IDENTIFIER, sizeof(IDENTIFIER)) != 0 ) return false;
+
+    FormatInfo info;
+    if( !formatInfo(header.vkFormat, info) || header.supercompressionScheme != 0 ||
+        header.pixelDepth > 1 || header.layerCount > 1 || (header.faceCount != 1 && header.faceCount != 6) ) {
+        return false;
+    }
+
+    uint32_t levelCount = std::max(header.levelCount, 1u);
+    std::vector<LevelIndex> index(levelCount);
+    in.read((char *)index.data(), index.size() * sizeof(LevelIndex));
+    if( !in ) return false;
+
+    image.vkFormat = header.vkFormat;
+    image.width = header.pixelWidth;
+    image.height = header.pixelHeight;
+    image.faces = (int)header.faceCount;
+    image.levels.assign(levelCount, std::vector<unsigned char>());
+    for( uint32_t i = 0; i < levelCount; i++ ) {
+        if( (int)i < firstLevel || (int)i >= endLevel ) continue;
+        image.levels[i].resize((size_t)index[i].byteLength);
+        in.seekg((std::streamoff)index[i].byteOffset);
+        in.read((char *)image.levels[i].data(), image.levels[i].size());
+        if( !in ) return false;
+    }
+    return true;
+}
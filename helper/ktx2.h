@@ -0,0 +1,39 @@
+#pragma once
+
+#include <climits>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Minimal KTX2 container support for cooked textures: single 2D images with a mip
+// chain of block compressed levels, or cube maps in one of the HDR formats, with no
+// supercompression. 2D levels are stored bottom row first, as OpenGL expects, and cube
+// map faces top row first, as OpenGL reads them. Either is recorded in the KTXorientation key.
+namespace Ktx2 {
+
+    // Vulkan format numbers, as KTX2 identifies formats by them
+    enum VkFormat : uint32_t {
+        VK_FORMAT_BC4_UNORM_BLOCK = 139,
+        VK_FORMAT_BC5_UNORM_BLOCK = 141,
+        VK_FORMAT_BC7_UNORM_BLOCK = 145,
+        VK_FORMAT_BC7_SRGB_BLOCK = 146,
+        VK_FORMAT_R16G16B16A16_SFLOAT = 97,
+        VK_FORMAT_R32G32B32_SFLOAT = 106,
+        VK_FORMAT_E5B9G9R9_UFLOAT_PACK32 = 123
+    };
+
+    struct Image {
+        uint32_t vkFormat;
+        int width, height;
+        std::vector<std::vector<unsigned char>> levels;   // Level 0 (largest) first. A cube map level holds
+                                                          // its faces one after another, +X first.
+        int faces = 1;                                    // 6 for a cube map
+    };
+
+    bool write( const std::string & fName, const Image & image );
+
+    // False if the file is missing, or is not a KTX2 file this reader understands. Only levels
+    // firstLevel to endLevel - 1 are read, the others are left empty, as the level index lets
+    // each one be read on its own. An empty range reads just the header.
+    bool read( const std::string & fName, Image & image, int firstLevel = 0, int endLevel = INT_MAX );
+}
@@ -0,0 +1,63 @@
+#include "mappedfile.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+
+MappedFile::MappedFile(const std::string & fName) :
+    bytes(nullptr), length(0), file(INVALID_HANDLE_VALUE), mapping(nullptr)
+{
+    file = CreateFileA(fName.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                       FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if( file == INVALID_HANDLE_VALUE ) return;
+
+    LARGE_INTEGER fileSize;
+    if( !GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0 ) return;
+
+    mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if( mapping == nullptr ) return;
+
+    bytes = (const unsigned char *)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if( bytes != nullptr ) length = (size_t)fileSize.QuadPart;
+}
+
+MappedFile::~MappedFile() {
+    if( bytes != nullptr ) UnmapViewOfFile(bytes);
+    if( mapping != nullptr ) CloseHandle(mapping);
+    if( file != INVALID_HANDLE_VALUE ) CloseHandle(file);
+}
+
+#else
+
+MappedFile::MappedFile(const std::string & fName) : bytes(nullptr), length(0)
+{
+    int fd = open(fName.c_str(), O_RDONLY);
+    if( fd < 0 ) return;
+
+    struct stat info;
+    if( fstat(fd, &info) == 0 && info.st_size > 0 ) {
+        void * mapped = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if( mapped != MAP_FAILED ) {
+            // Read front to back, once
+            madvise(mapped, (size_t)info.st_size, MADV_SEQUENTIAL);
+            bytes = (const unsigned char *)mapped;
+            length = (size_t)info.st_size;
+        }
+    }
+    close(fd);   // The mapping stays valid
+}
+
+MappedFile::~MappedFile() {
+    if( bytes != nullptr ) munmap((void *)bytes, length);
+}
+
+#endif
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+// A whole file mapped read only into memory, so it can be parsed in place without
+// copying it into a buffer first.
+class MappedFile
+{
+public:
+    explicit MappedFile(const std::string & fName);
+    ~MappedFile();
+
+    // Make it non-copyable.
+    MappedFile(const MappedFile &) = delete;
+    MappedFile & operator=(const MappedFile &) = delete;
+
+    // False if the file is missing or empty
+    bool isOpen() const { return bytes != nullptr; }
+
+    const unsigned char * data() const { return bytes; }
+    size_t size() const { return length; }
+
+private:
+    const unsigned char * bytes;
+    size_t length;
+#ifdef _WIN32
+    void * file;
+    void * mapping;
+#endif
+};
@@ -0,0 +1,206 @@
+#include "materialtable.h"
+#include "threadpool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <future>
+#include <iostream>
+
+namespace {
+    // Material entries stand in with this until their maps are uploaded: matte mid grey, with no fetches
+    const MaterialTable::Constants PLACEHOLDER(MaterialTable::Constants::ALL, glm::vec3(0.216f), 1.0f, 1.0f, 0.0f);
+
+    // True unless data is just a cooked file's header (see Texture::prepareLevels)
+    bool hasImages(const Texture::Data & data) {
+        return !data.images.empty() && !data.images[0].empty();
+    }
+}
+
+static_assert(sizeof(MaterialTable::MaterialData) == 64, "MaterialData doesn't match the std430 MaterialInfo in pbr.frag");
+
+MaterialTable::MaterialTable() : buffer(0), allocatedBytes(0)
+{ }
+
+MaterialTable::~MaterialTable() {
+    if( !arrays.empty() ) glDeleteTextures((GLsizei)arrays.size(), arrays.data());   // Skips the 0s
+    if( buffer != 0 ) glDeleteBuffers(1, &buffer);
+}
+
+int MaterialTable::addMap(const Texture::Request & request) {
+    for( size_t i = 0; i < maps.size(); i++ ) {
+        if( maps[i].fName == request.fName && maps[i].options == request.options ) return (int)i;
+    }
+    maps.push_back(request);
+    return (int)maps.size() - 1;
+}
+
+int MaterialTable::add(const Texture::Request & albedo, const Texture::Request & normal, const Texture::Request & orm,
+                       const Constants & materialConstants) {
+    materials.push_back(materialConstants.has(Constants::ALBEDO) ? -1 : addMap(albedo));
+    materials.push_back(materialConstants.has(Constants::NORMAL) ? -1 : addMap(normal));
+    materials.push_back(materialConstants.has(Constants::ORM) ? -1 : addMap(orm));
+    constants.push_back(materialConstants);
+    return size() - 1;
+}
+
+void MaterialTable::build() {
+    // Only the headers of cooked maps are read now, to size the arrays. Maps that aren't
+    // cooked yet are cooked (or uncompressed ones decoded) now, and read again when requested.
+    ThreadPool & pool = ThreadPool::shared();
+    std::vector<std::future<Texture::Data>> jobs;
+    for( const Texture::Request & request : maps ) {
+        jobs.push_back(pool.submit([request]() {
+            Texture::Data header = Texture::prepareLevels(request.fName, request.options, 0, 0);
+            if( header.internalFormat != 0 ) return header;
+            return Texture::prepareTexture(request.fName, request.options);
+        }));
+    }
+
+    // The driver may have fewer units than FIRST_UNIT + MAX_ARRAYS
+    GLint units = 0;
+    glGetIntegerv(GL_MAX_TEXTURE_IMAGE_UNITS, &units);
+    int maxArrays = std::max(0, units - (int)FIRST_UNIT);
+    if( maxArrays > MAX_ARRAYS ) maxArrays = MAX_ARRAYS;
+
+    arrayOf.assign(maps.size(), -1);
+    layerOf.assign(maps.size(), 0);
+    mapStates.assign(maps.size(), MapState::Failed);
+    loads.resize(maps.size());
+
+    for( size_t i = 0; i < maps.size(); i++ ) {
+        Texture::Data d = jobs[i].get();
+        std::cout << d.message;
+        if( d.internalFormat == 0 || d.width == 0 ) continue;
+
+        auto it = std::find_if(buckets.begin(), buckets.end(), [&d](const Bucket & b) {
+            return b.internalFormat == d.internalFormat && b.width == d.width && b.height == d.height && b.levels == d.levels;
+        });
+        if( it == buckets.end() ) {
+            if( (int)buckets.size() == maxArrays ) {
+                std::cerr << "No texture array left for " << maps[i].fName << std::endl;
+                continue;
+            }
+            it = buckets.insert(buckets.end(), { d.internalFormat, d.width, d.height, d.levels, 0 });
+        }
+        arrayOf[i] = (GLint)(it - buckets.begin());
+        layerOf[i] = it->layers++;
+        mapStates[i] = MapState::Deferred;
+    }
+    arrays.assign(buckets.size(), 0);
+
+    requested.assign(size(), false);
+    ready.assign(size(), false);
+    std::vector<MaterialData> table(size());
+    for( int m = 0; m < size(); m++ ) {
+        ready[m] = mapsSettled(m);
+        table[m] = entry(m, ready[m]);
+    }
+
+    glCreateBuffers(1, &buffer);
+    glNamedBufferStorage(buffer, std::max<size_t>(1, table.size()) * sizeof(MaterialData), table.data(), GL_DYNAMIC_STORAGE_BIT);
+
+    std::cout << "Material arrays: " << size() << " materials, " << maps.size() << " maps in "
+              << arrays.size() << " arrays, loaded on first use" << std::endl;
+}
+
+void MaterialTable::request(int material) {
+    if( material < 0 || material >= size() || requested[material] ) return;
+    requested[material] = true;
+
+    for( int i = 0; i < 3; i++ ) {
+        int map = materials[material * 3 + i];
+        if( map < 0 || mapStates[map] != MapState::Deferred ) continue;
+        Texture::Request request = maps[map];
+        loads[map] = ThreadPool::shared().submit([request]() { return Texture::prepareTexture(request.fName, request.options); });
+        mapStates[map] = MapState::Loading;
+    }
+}
+
+void MaterialTable::update() {
+    for( size_t i = 0; i < maps.size(); i++ ) {
+        if( mapStates[i] != MapState::Loading ||
+            loads[i].wait_for(std::chrono::seconds(0)) != std::future_status::ready ) {
+            continue;
+        }
+        Texture::Data data = loads[i].get();
+        std::cout << data.message;
+
+        // The cooked file could have changed since its header was read
+        const Bucket & bucket = buckets[arrayOf[i]];
+        if( !hasImages(data) || data.internalFormat != bucket.internalFormat || data.width != bucket.width ||
+            data.height != bucket.height || data.levels != bucket.levels ) {
+            std::cerr << "Unable to load " << maps[i].fName << " into its texture array" << std::endl;
+            arrayOf[i] = -1;
+            mapStates[i] = MapState::Failed;
+            continue;
+        }
+        uploadLayer((int)i, data);
+        mapStates[i] = MapState::Resident;
+    }
+
+    for( int m = 0; m < size(); m++ ) {
+        if( ready[m] || !requested[m] || !mapsSettled(m) ) continue;
+        ready[m] = true;
+        MaterialData data = entry(m, true);
+        glNamedBufferSubData(buffer, (GLintptr)(m * sizeof(MaterialData)), sizeof(MaterialData), &data);
+    }
+}
+
+void MaterialTable::uploadLayer(int map, const Texture::Data & data) {
+    GLuint & array = arrays[arrayOf[map]];
+    if( array == 0 ) {
+        // Every layer has the same size as this one
+        const Bucket & bucket = buckets[arrayOf[map]];
+        glCreateTextures(GL_TEXTURE_2D_ARRAY, 1, &array);
+        glTextureStorage3D(array, bucket.levels, bucket.internalFormat, bucket.width, bucket.height, bucket.layers);
+        Texture::setParameters(array, GL_TEXTURE_2D_ARRAY);
+        glBindTextureUnit(FIRST_UNIT + arrayOf[map], array);
+        allocatedBytes += data.storageBytes() * bucket.layers;
+    }
+
+    for( int level = 0; level < data.levels; level++ ) {
+        const std::vector<unsigned char> & image = data.images[level];
+        int w = std::max(1, data.width >> level), h = std::max(1, data.height >> level);
+        if( data.compressed() ) {
+            glCompressedTextureSubImage3D(array, level, 0, 0, layerOf[map], w, h, 1, data.internalFormat,
+                                          (GLsizei)image.size(), image.data());
+        } else {
+            glTextureSubImage3D(array, level, 0, 0, layerOf[map], w, h, 1, data.format, data.type, image.data());
+        }
+    }
+}
+
+bool MaterialTable::mapsSettled(int material) const {
+    for( int i = 0; i < 3; i++ ) {
+        int map = materials[material * 3 + i];
+        if( map >= 0 && (mapStates[map] == MapState::Deferred || mapStates[map] == MapState::Loading) ) return false;
+    }
+    return true;
+}
+
+MaterialTable::MaterialData MaterialTable::entry(int material, bool mapsReady) const {
+    MaterialData data;
+    GLint * entries[] = { data.albedo, data.normal, data.orm };
+    for( int i = 0; i < 3; i++ ) {
+        int map = materials[material * 3 + i];
+        entries[i][0] = (map < 0) ? -1 : arrayOf[map];
+        entries[i][1] = (map < 0) ? 0 : layerOf[map];
+    }
+    data.padding[0] = data.padding[1] = 0;
+
+    const Constants & c = mapsReady ? constants[material] : PLACEHOLDER;
+    data.constantAlbedo[0] = c.albedo.x;
+    data.constantAlbedo[1] = c.albedo.y;
+    data.constantAlbedo[2] = c.albedo.z;
+    data.constantAlbedo[3] = 1.0f;
+    data.constantOrm[0] = c.ao;
+    data.constantOrm[1] = c.roughness;
+    data.constantOrm[2] = c.metallic;
+    data.constantChannels = c.channels;
+    return data;
+}
+
+void MaterialTable::bind() const {
+    glBindTextures(FIRST_UNIT, (GLsizei)arrays.size(), arrays.data());
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, BINDING, buffer);
+}
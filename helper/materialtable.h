@@ -0,0 +1,143 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include "texture.h"
+
+#include <future>
+#include <vector>
+
+// PBR maps of many materials stored as layers of GL_TEXTURE_2D_ARRAYs, with a shader
+// storage buffer saying which array and layer each material's maps are in. pbr.frag
+// looks its maps up through MaterialIndex when MaterialArrays is set, so changing
+// material between draws is one uniform rather than rebinding textures.
+//
+// Maps are loaded lazily: build() only reads cooked files' headers to size the arrays, and
+// a material's layers are uploaded once it is requested, normally when something drawn with
+// it is first on screen. Until then its entry holds placeholder constants, so it draws as
+// plain grey without sampling the arrays. Each array's storage, which holds every level of
+// every layer, is only allocated with its first layer, so a table that is never drawn from
+// takes no GPU memory.
+//
+// Maps only share an array when their format, size and level count match, so a 1x1
+// constant and a 1024x1024 map each get an array of their own size, and sRGB albedo
+// maps never share with the linear ORM images, though both are BC7. The arrays are
+// bound to consecutive units from FIRST_UNIT.
+//
+// Material layout (std430, 64 bytes):
+//   ivec2 albedo, normal, orm    array index and layer of each map, array -1 if it failed to load
+//                                or is constant
+//   vec4 constantAlbedo          rgb, linear
+//   vec3 constantOrm             occlusion, roughness, metallic
+//   uint constantChannels        Constants::Channel flags
+class MaterialTable
+{
+public:
+    // Values a material uses in place of maps, so surfaces without detail skip their fetches.
+    // Each flagged channel's map is neither loaded nor sampled. The packed ORM map is still
+    // sampled while any of its three channels isn't constant, with the constants replacing the rest.
+    struct Constants {
+        enum Channel : GLuint {
+            ALBEDO = 1,
+            NORMAL = 2,         // Flat, so no value
+            AO = 4,
+            ROUGHNESS = 8,
+            METALLIC = 16,
+            ORM = AO | ROUGHNESS | METALLIC,
+            ALL = ALBEDO | NORMAL | ORM
+        };
+
+        GLuint channels;
+        glm::vec3 albedo;       // Linear, not sRGB
+        float ao, roughness, metallic;
+
+        Constants(GLuint channels = 0, const glm::vec3 & albedo = glm::vec3(0.0f),
+                  float ao = 1.0f, float roughness = 0.0f, float metallic = 0.0f) :
+            channels(channels), albedo(albedo), ao(ao), roughness(roughness), metallic(metallic) { }
+
+        bool has(GLuint channel) const { return (channels & channel) == channel; }
+    };
+
+    // Binding point of the MaterialBuffer block in pbr.frag
+    static const GLuint BINDING = 2;
+
+    // Units of the MaterialMaps sampler array in pbr.frag. GL only promises 16 units per
+    // shader stage, so fewer arrays are used where the driver has fewer than FIRST_UNIT + MAX_ARRAYS.
+    static const GLuint FIRST_UNIT = 9;
+    static const int MAX_ARRAYS = 9;
+
+    struct MaterialData {
+        GLint albedo[2];
+        GLint normal[2];
+        GLint orm[2];
+        GLint padding[2];
+        GLfloat constantAlbedo[4];
+        GLfloat constantOrm[3];
+        GLuint constantChannels;
+    };
+
+    MaterialTable();
+    ~MaterialTable();
+
+    // Make it non-copyable.
+    MaterialTable(const MaterialTable &) = delete;
+    MaterialTable & operator=(const MaterialTable &) = delete;
+
+    // Add a material, returning its index. Must be called before build. Requests for
+    // channels in constants are ignored, and may be left empty.
+    int add(const Texture::Request & albedo, const Texture::Request & normal, const Texture::Request & orm,
+            const Constants & constants = Constants());
+
+    // Size the arrays and upload the material buffer, reading cooked maps' headers
+    // concurrently on ThreadPool::shared(). Maps that aren't cooked yet are cooked now.
+    // Maps shared between materials load once.
+    void build();
+
+    // Start loading a material's maps on ThreadPool::shared(), if they aren't already
+    void request(int material);
+
+    // Call once per frame on the GL thread. Uploads the maps that have loaded, and switches
+    // materials whose maps are all in from their placeholder.
+    void update();
+
+    // Bind the arrays and material buffer. Draws then only differ by material index.
+    void bind() const;
+
+    int size() const { return (int)constants.size(); }
+    int arrayCount() const { return (int)arrays.size(); }
+
+    // GPU memory of the arrays allocated so far
+    size_t residentBytes() const { return allocatedBytes; }
+
+private:
+    enum class MapState { Deferred, Loading, Resident, Failed };
+
+    // Maps that can share an array
+    struct Bucket {
+        GLenum internalFormat;
+        int width, height, levels;
+        GLsizei layers;
+    };
+
+    GLuint buffer;
+    std::vector<GLuint> arrays;           // 0 until their first layer is uploaded
+    std::vector<Bucket> buckets;          // Per array
+    std::vector<Texture::Request> maps;   // Each distinct map once
+    std::vector<int> materials;           // Albedo, normal and ORM index into maps, per material, -1 if constant
+    std::vector<Constants> constants;     // Per material
+    size_t allocatedBytes;
+
+    // Per map
+    std::vector<GLint> arrayOf, layerOf;  // Array -1 if it failed to load
+    std::vector<MapState> mapStates;
+    std::vector<std::future<Texture::Data>> loads;
+
+    // Per material
+    std::vector<bool> requested;
+    std::vector<bool> ready;              // Its entry no longer holds the placeholder
+
+    int addMap(const Texture::Request & request);
+    void uploadLayer(int map, const Texture::Data & data);
+    bool mapsSettled(int material) const;     // None of its maps are still to load
+    MaterialData entry(int material, bool mapsReady) const;
+};
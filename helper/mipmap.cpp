@@ -0,0 +1,136 @@
+#include "mipmap.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+    const float PI = 3.14159265358979f;
+
+    // Kaiser window parameters. Radius is in output texels.
+    const float KAISER_RADIUS = 3.0f;
+    const float KAISER_ALPHA = 4.0f;
+
+    float srgbToLinear(float c) {
+        return (c <= 0.04045f) ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+    }
+
+    float linearToSrgb(float c) {
+        return (c <= 0.0031308f) ? c * 12.92f : 1.055f * std::pow(c, 1.0f / 2.4f) - 0.055f;
+    }
+
+    // Zeroth order modified Bessel function of the first kind
+    float besselI0(float x) {
+        float sum = 1.0f, term = 1.0f;
+        for( int k = 1; k < 20; k++ ) {
+            term *= (x / (2.0f * k)) * (x / (2.0f * k));
+            sum += term;
+        }
+        return sum;
+    }
+
+    float sinc(float x) {
+        if( std::fabs(x) < 1.0e-5f ) return 1.0f;
+        return std::sin(PI * x) / (PI * x);
+    }
+
+    // Filter weight at distance x, measured in output texels
+    float filterWeight(MipMap::Filter filter, float x) {
+        x = std::fabs(x);
+        if( filter == MipMap::Filter::Box ) {
+            if( x < 0.5f ) return 1.0f;
+            return (x == 0.5f) ? 0.5f : 0.0f;
+        }
+        if( x >= KAISER_RADIUS ) return 0.0f;
+        float r = x / KAISER_RADIUS;
+        return sinc(x) * besselI0(KAISER_ALPHA * std::sqrt(1.0f - r * r)) / besselI0(KAISER_ALPHA);
+    }
+
+    struct Tap {
+        int src;
+        float weight;
+    };
+
+    // Taps for each output texel when resampling one dimension from srcSize to dstSize.
+    // Texels off the edge are clamped to it.
+    std::vector<std::vector<Tap>> makeTaps(MipMap::Filter filter, int srcSize, int dstSize) {
+        float scale = (float)srcSize / dstSize;
+        float support = (filter == MipMap::Filter::Box ? 0.5f : KAISER_RADIUS) * scale;
+
+        std::vector<std::vector<Tap>> taps(dstSize);
+        for( int i = 0; i < dstSize; i++ ) {
+            float centre = (i + 0.5f) * scale;   // In source texels
+            int first = (int)std::floor(centre - support - 0.5f);
+            int last = (int)std::ceil(centre + support - 0.5f);
+
+            float total = 0.0f;
+            for( int j = first; j <= last; j++ ) {
+                float w = filterWeight(filter, ((j + 0.5f) - centre) / scale);
+                if( w == 0.0f ) continue;
+                taps[i].push_back({ std::min(std::max(j, 0), srcSize - 1), w });
+                total += w;
+            }
+            for( Tap & t : taps[i] ) t.weight /= total;
+        }
+        return taps;
+    }
+
+    // Resample a linear float RGBA image to dstW x dstH, horizontally then vertically
+    std::vector<float> resample(MipMap::Filter filter, const std::vector<float> & src, int srcW, int srcH, int dstW, int dstH) {
+        std::vector<std::vector<Tap>> xTaps = makeTaps(filter, srcW, dstW);
+        std::vector<std::vector<Tap>> yTaps = makeTaps(filter, srcH, dstH);
+
+        std::vector<float> rows((size_t)dstW * srcH * 4, 0.0f);
+        for( int y = 0; y < srcH; y++ ) {
+            const float * srcRow = &src[(size_t)y * srcW * 4];
+            float * dstRow = &rows[(size_t)y * dstW * 4];
+            for( int x = 0; x < dstW; x++ ) {
+                for( const Tap & t : xTaps[x] ) {
+                    for( int c = 0; c < 4; c++ ) dstRow[x*4 + c] += t.weight * srcRow[t.src*4 + c];
+                }
+            }
+        }
+
+        std::vector<float> dst((size_t)dstW * dstH * 4, 0.0f);
+        for( int y = 0; y < dstH; y++ ) {
+            float * dstRow = &dst[(size_t)y * dstW * 4];
+            for( const Tap & t : yTaps[y] ) {
+                const float * srcRow = &rows[(size_t)t.src * dstW * 4];
+                for( int i = 0; i < dstW * 4; i++ ) dstRow[i] += t.weight * srcRow[i];
+            }
+        }
+        return dst;
+    }
+}
+
+std::vector<MipMap::Level> MipMap::generate(const unsigned char * rgba, int width, int height, Filter filter, bool srgb) {
+    float decode[256];
+    for( int i = 0; i < 256; i++ ) decode[i] = srgb ? srgbToLinear(i / 255.0f) : i / 255.0f;
+
+    // Work in linear float, filtering each level from the one above it
+    std::vector<float> current((size_t)width * height * 4);
+    for( size_t i = 0; i < current.size(); i++ ) {
+        current[i] = ((i & 3) == 3) ? rgba[i] / 255.0f : decode[rgba[i]];
+    }
+
+    std::vector<Level> levels;
+    int w = width, h = height;
+    while( w > 1 || h > 1 ) {
+        int nw = std::max(1, w / 2), nh = std::max(1, h / 2);
+        current = resample(filter, current, w, h, nw, nh);
+        w = nw;
+        h = nh;
+
+        Level level;
+        level.width = w;
+        level.height = h;
+        level.texels.resize(current.size());
+        for( size_t i = 0; i < current.size(); i++ ) {
+            // The Kaiser filter's negative lobes can overshoot, so clamp
+            float v = std::min(std::max(current[i], 0.0f), 1.0f);
+            if( srgb && (i & 3) != 3 ) v = linearToSrgb(v);
+            level.texels[i] = (unsigned char)(v * 255.0f + 0.5f);
+        }
+        levels.push_back(std::move(level));
+    }
+    return levels;
+}
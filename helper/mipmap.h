@@ -0,0 +1,23 @@
+#pragma once
+
+#include <vector>
+
+// CPU generation of mip chains for 8-bit RGBA images
+namespace MipMap {
+
+    enum class Filter {
+        Box,    // Average of the texels each output texel covers. Cheap, slightly soft.
+        Kaiser  // Kaiser windowed sinc. Sharper distant detail with little ringing.
+    };
+
+    struct Level {
+        int width, height;
+        std::vector<unsigned char> texels;  // RGBA, tightly packed
+    };
+
+    // Every level below the given base level, each half the size of the one above (rounded
+    // down, minimum 1). With srgb set, RGB is decoded to linear before filtering and encoded
+    // again afterwards, so that averages are of light rather than of encoded values. Alpha
+    // is always treated as linear.
+    std::vector<Level> generate(const unsigned char * rgba, int width, int height, Filter filter, bool srgb);
+}
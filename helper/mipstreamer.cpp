@@ -0,0 +1,307 @@
+#include "mipstreamer.h"
+#include "threadpool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+
+namespace {
+    // Slot value when no fragment of the material was drawn
+    const GLuint NO_REQUEST = 0xFFFFFFFF;
+
+    // How the shaders encode a footprint: uint((log2 + 32) * 8)
+    float decodeFootprint(GLuint request) {
+        return request / 8.0f - 32.0f;
+    }
+
+    size_t levelSize(GLenum internalFormat, int width, int height, int level) {
+        size_t blockBytes = (internalFormat == GL_COMPRESSED_RED_RGTC1) ? 8 : 16;
+        size_t w = (size_t)std::max(1, width >> level), h = (size_t)std::max(1, height >> level);
+        return (w + 3) / 4 * ((h + 3) / 4) * blockBytes;
+    }
+}
+
+MipStreamer::MipStreamer(int slots, int tailSize, int evictFrames, size_t frameBudget) :
+    slots(slots), tailSize(tailSize), evictFrames(evictFrames), frameBudget(frameBudget), budget(0), fixedBytes(0), reservedBytes(0),
+    current(0), bound(false), nextSerial(0), feedbackFrame(0), counts()
+{
+    GLbitfield flags = GL_MAP_READ_BIT | GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    glCreateBuffers(FRAMES_IN_FLIGHT, buffers);
+    for( int i = 0; i < FRAMES_IN_FLIGHT; i++ ) {
+        glNamedBufferStorage(buffers[i], slots * sizeof(GLuint), nullptr, flags);
+        requests[i] = (GLuint *)glMapNamedBufferRange(buffers[i], 0, slots * sizeof(GLuint), flags);
+        std::fill(requests[i], requests[i] + slots, NO_REQUEST);
+        fences[i] = 0;
+    }
+}
+
+MipStreamer::~MipStreamer() {
+    for( Load & load : loads ) load.data.wait();
+    for( int i = 0; i < FRAMES_IN_FLIGHT; i++ ) {
+        if( fences[i] != 0 ) glDeleteSync(fences[i]);
+        glUnmapNamedBuffer(buffers[i]);
+    }
+    glDeleteBuffers(FRAMES_IN_FLIGHT, buffers);
+}
+
+GLuint MipStreamer::load(const std::string & fName, const Texture::Options & options, Resident resident) {
+    GLuint texture;
+    glCreateTextures(GL_TEXTURE_2D, 1, &texture);
+
+    Streamed & streamed = textures[texture];
+    streamed = Streamed();   // Zeroed, as the name may be a released one
+    streamed.fName = fName;
+    streamed.options = options;
+    streamed.resident = resident;
+    streamed.serial = nextSerial++;
+    streamed.loading = true;
+
+    int maxSize = tailSize;
+    loads.push_back({ texture, streamed.serial, 0, ThreadPool::shared().submit([fName, options, maxSize]() {
+        return Texture::prepareTexture(fName, options, maxSize);
+    }) });
+    return texture;
+}
+
+void MipStreamer::addSlot(GLuint texture, int slot) {
+    auto it = textures.find(texture);
+    if( it == textures.end() ) return;
+    std::vector<int> & textureSlots = it->second.slots;
+    if( std::find(textureSlots.begin(), textureSlots.end(), slot) == textureSlots.end() ) textureSlots.push_back(slot);
+}
+
+void MipStreamer::release(GLuint texture) {
+    // Any load still running for it is dropped when it completes
+    textures.erase(texture);
+}
+
+void MipStreamer::update() {
+    // Fence the frame just drawn, whose shaders wrote the current buffer
+    if( bound ) {
+        glMemoryBarrier(GL_CLIENT_MAPPED_BUFFER_BARRIER_BIT);
+        if( fences[current] != 0 ) glDeleteSync(fences[current]);   // An unread frame's, which this one covers
+        fences[current] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        current = (current + 1) % FRAMES_IN_FLIGHT;
+    }
+
+    // The next buffer was drawn into FRAMES_IN_FLIGHT - 1 frames ago, so is normally long finished.
+    // If the GPU is further behind, its requests are left for this frame's draws to add to, and
+    // read once those are done.
+    if( fences[current] != 0 ) {
+        GLenum status = glClientWaitSync(fences[current], GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+        if( status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED ) {
+            glDeleteSync(fences[current]);
+            fences[current] = 0;
+            readFeedback(requests[current]);
+            std::fill(requests[current], requests[current] + slots, NO_REQUEST);
+        }
+    }
+
+    // Commit finished loads, up to the frame's byte budget
+    GLint previous = 0;
+    glGetIntegerv(GL_TEXTURE_BINDING_2D, &previous);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    size_t budget = frameBudget;
+    for( auto it = loads.begin(); it != loads.end(); ) {
+        if( budget == 0 || it->data.wait_for(std::chrono::seconds(0)) != std::future_status::ready ) {
+            ++it;
+            continue;
+        }
+
+        Texture::Data data = it->data.get();
+        reservedBytes -= it->reserved;
+        auto texture = textures.find(it->texture);
+        if( texture != textures.end() && texture->second.serial == it->serial ) {
+            budget -= std::min(budget, data.storageBytes());
+            commit(texture->second, it->texture, data);
+        }
+        it = loads.erase(it);
+    }
+    glBindTexture(GL_TEXTURE_2D, previous);
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, FEEDBACK_BINDING, buffers[current]);
+    bound = true;
+}
+
+void MipStreamer::readFeedback(const GLuint * frameRequests) {
+    feedbackFrame++;
+
+    // Finest level each texture needs, or just its tail if none of its materials were drawn.
+    // All are found first, so the budget knows which textures this frame drew.
+    for( auto & entry : textures ) {
+        Streamed & texture = entry.second;
+        if( texture.internalFormat == 0 ) continue;   // Tail still loading
+        texture.needed = texture.tail;
+        for( int slot : texture.slots ) {
+            if( slot < 0 || slot >= slots || frameRequests[slot] == NO_REQUEST ) continue;
+            float level = std::log2((float)std::max(texture.width, texture.height)) + decodeFootprint(frameRequests[slot]);
+            texture.needed = std::min(texture.needed, std::max(0, (int)std::floor(level)));
+            texture.lastDrawn = feedbackFrame;
+        }
+    }
+
+    for( auto & entry : textures ) {
+        Streamed & texture = entry.second;
+        if( texture.internalFormat == 0 ) continue;   // Tail still loading
+        bool drawn = (texture.lastDrawn == feedbackFrame);
+
+        if( texture.needed < texture.base ) {
+            counts.misses++;
+            texture.coarserFrames = 0;
+            if( texture.loading ) continue;
+
+            // As many of the missing levels as the budget allows, coarsest first
+            int firstLevel = texture.needed;
+            size_t bytes = bytesFrom(texture, firstLevel) - bytesFrom(texture, texture.base);
+            while( firstLevel < texture.base && !makeRoom(bytes) ) {
+                bytes -= texture.levelBytes[firstLevel];
+                firstLevel++;
+            }
+            if( firstLevel == texture.base ) continue;
+
+            // Read just those levels
+            texture.loading = true;
+            reservedBytes += bytes;
+            std::string fName = texture.fName;
+            Texture::Options options = texture.options;
+            int endLevel = texture.base;
+            loads.push_back({ entry.first, texture.serial, bytes, ThreadPool::shared().submit([fName, options, firstLevel, endLevel]() {
+                return Texture::prepareLevels(fName, options, firstLevel, endLevel);
+            }) });
+        } else if( texture.needed > texture.base ) {
+            if( drawn ) counts.hits++;
+
+            // Only let go once a level has gone unused for a while, so they don't thrash
+            texture.wanted = (texture.coarserFrames == 0) ? texture.needed : std::min(texture.wanted, texture.needed);
+            if( ++texture.coarserFrames >= evictFrames && !texture.loading ) {
+                counts.releasedLevels += std::min(texture.wanted, texture.tail) - texture.base;
+                evict(texture, entry.first, texture.wanted);
+                texture.coarserFrames = 0;
+            }
+        } else {
+            if( drawn ) counts.hits++;
+            texture.coarserFrames = 0;
+        }
+    }
+
+    // Back within a budget that was lowered
+    makeRoom(0);
+}
+
+// Evict levels of the least recently drawn textures, finest first, until bytes more fit in
+// the budget. Textures drawn in the latest feedback are kept, so returns false, evicting
+// nothing, if they alone leave no room. With bytes 0, it gets as close to the budget as it can.
+bool MipStreamer::makeRoom(size_t bytes) {
+    if( budget == 0 ) return true;
+    size_t used = fixedBytes + residentBytes() + reservedBytes + bytes;
+    if( used <= budget ) return true;
+
+    std::vector<std::pair<unsigned long long, GLuint>> candidates;
+    size_t evictable = 0;
+    for( const auto & entry : textures ) {
+        const Streamed & texture = entry.second;
+        if( texture.internalFormat == 0 || texture.loading || texture.lastDrawn == feedbackFrame || texture.base >= texture.tail ) continue;
+        candidates.push_back({ texture.lastDrawn, entry.first });
+        evictable += bytesFrom(texture, texture.base) - bytesFrom(texture, texture.tail);
+    }
+    if( used - evictable > budget && bytes != 0 ) return false;
+
+    std::sort(candidates.begin(), candidates.end());
+    for( const auto & candidate : candidates ) {
+        Streamed & texture = textures[candidate.second];
+        while( texture.base < texture.tail && used > budget ) {
+            used -= texture.levelBytes[texture.base];
+            texture.evictedMask |= 1u << texture.base;
+            counts.evictedLevels++;
+            evict(texture, candidate.second, texture.base + 1);
+        }
+        if( used <= budget ) break;
+    }
+    return used <= budget;
+}
+
+// Add a load's levels to the texture. The caller restores the 2D texture binding.
+void MipStreamer::commit(Streamed & texture, GLuint name, Texture::Data & data) {
+    texture.loading = false;
+    std::cout << data.message;
+    if( data.internalFormat == 0 || data.width == 0 ) {
+        // The cooked file changed under it, so stop asking until the texture is loaded again
+        if( texture.internalFormat != 0 ) {
+            std::cerr << "Unable to stream levels of " << texture.fName << ", leaving it at level " << texture.base << std::endl;
+            texture.slots.clear();
+        }
+        return;
+    }
+
+    bool first = (texture.internalFormat == 0);
+    if( first ) {
+        texture.internalFormat = data.internalFormat;
+        texture.width = data.width;
+        texture.height = data.height;
+        texture.tail = texture.base = data.levels;
+        for( int level = 0; level < data.levels; level++ ) {
+            texture.levelBytes.push_back(levelSize(data.internalFormat, data.width, data.height, level));
+        }
+    }
+
+    // Levels must join the ones already resident, as the level index is counted from full size
+    int endLevel = std::min(texture.base, data.levels);
+    glBindTexture(GL_TEXTURE_2D, name);
+    for( int level = data.baseLevel; level < endLevel; level++ ) {
+        const std::vector<unsigned char> & image = data.images[level];
+        int w = std::max(1, data.width >> level), h = std::max(1, data.height >> level);
+        glCompressedTexImage2D(GL_TEXTURE_2D, level, data.internalFormat, w, h, 0, (GLsizei)image.size(), image.data());
+    }
+    if( first ) {
+        Texture::setParameters(name, GL_TEXTURE_2D);
+        glTextureParameteri(name, GL_TEXTURE_MAX_LEVEL, data.levels - 1);
+        texture.tail = data.baseLevel;
+    } else {
+        for( int level = data.baseLevel; level < endLevel; level++ ) {
+            if( texture.evictedMask & (1u << level) ) counts.reloadedLevels++;
+            texture.evictedMask &= ~(1u << level);
+        }
+        counts.loadedLevels += endLevel - data.baseLevel;
+    }
+    glTextureParameteri(name, GL_TEXTURE_BASE_LEVEL, data.baseLevel);
+    texture.base = data.baseLevel;
+
+    if( texture.resident ) texture.resident(bytesFrom(texture, texture.base));
+}
+
+void MipStreamer::evict(Streamed & texture, GLuint name, int newBase) {
+    newBase = std::min(newBase, texture.tail);
+    if( newBase <= texture.base ) return;
+
+    // Raise the base first, then give the finer levels' memory back with empty images
+    GLint previous = 0;
+    glGetIntegerv(GL_TEXTURE_BINDING_2D, &previous);
+    glTextureParameteri(name, GL_TEXTURE_BASE_LEVEL, newBase);
+    glBindTexture(GL_TEXTURE_2D, name);
+    for( int level = texture.base; level < newBase; level++ ) {
+        glCompressedTexImage2D(GL_TEXTURE_2D, level, texture.internalFormat, 0, 0, 0, 0, nullptr);
+    }
+    glBindTexture(GL_TEXTURE_2D, previous);
+
+    texture.base = newBase;
+    if( texture.resident ) texture.resident(bytesFrom(texture, texture.base));
+}
+
+size_t MipStreamer::bytesFrom(const Streamed & texture, int level) const {
+    size_t bytes = 0;
+    for( int i = level; i < (int)texture.levelBytes.size(); i++ ) bytes += texture.levelBytes[i];
+    return bytes;
+}
+
+size_t MipStreamer::residentBytes() const {
+    size_t bytes = 0;
+    for( const auto & entry : textures ) bytes += bytesFrom(entry.second, entry.second.base);
+    return bytes;
+}
+
+size_t MipStreamer::fullBytes() const {
+    size_t bytes = 0;
+    for( const auto & entry : textures ) bytes += bytesFrom(entry.second, 0);
+    return bytes;
+}
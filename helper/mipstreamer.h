@@ -0,0 +1,129 @@
+#pragma once
+
+#include <glad/glad.h>
+#include "texture.h"
+
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <map>
+#include <string>
+#include <vector>
+
+// Streams the mip levels of block compressed textures on demand. A texture starts with
+// only its levels no larger than tailSize resident. Shaders then report, through a
+// feedback buffer, how fine a level each material needs on screen:
+//
+//     layout (std430, binding = 3) buffer MipFeedback { uint MipRequests[]; };
+//
+// Each slot holds the smallest texel footprint seen for one material, as log2 of its UV
+// derivatives, stored as uint((log2 + 32) * 8) with atomicMin. update() reads the frame
+// from FRAMES_IN_FLIGHT frames ago once its fence is signalled, so the GPU is never waited
+// on, loads any finer levels a texture needs from its cooked KTX2 file on ThreadPool::shared(),
+// and adds them by lowering GL_TEXTURE_BASE_LEVEL. Levels finer than a texture has needed for evictFrames frames (all
+// but the tail, when it is off screen) are released again, so memory follows what is visible.
+//
+// With a budget set, levels are only loaded while the resident levels fit in it, along with
+// the fixed bytes of textures the streamer doesn't manage. To make room, the finest levels
+// of the least recently drawn textures are evicted, and they are loaded again like any
+// others once those textures are back on screen. Tails and fixed bytes are never evicted,
+// so they alone can exceed the budget.
+//
+// Textures use mutable storage, one glCompressedTexImage2D per level, as immutable storage
+// can't release levels. Use only on the GL thread.
+class MipStreamer
+{
+public:
+    static const GLuint FEEDBACK_BINDING = 3;
+    static const int FRAMES_IN_FLIGHT = 3;
+
+    explicit MipStreamer(int slots = 64, int tailSize = 128, int evictFrames = 120, size_t frameBudget = 4 << 20);
+    ~MipStreamer();
+
+    MipStreamer(const MipStreamer &) = delete;
+    MipStreamer & operator=(const MipStreamer &) = delete;
+
+    // Called whenever a texture's resident levels change, with their size in bytes
+    using Resident = std::function<void(size_t)>;
+
+    // Queue the tail of a compressed texture. The name is returned straight away and samples
+    // as black until the tail arrives.
+    GLuint load(const std::string & fName, const Texture::Options & options, Resident resident = nullptr);
+
+    // Have texture follow the feedback in slot. A texture shared by several materials
+    // follows the finest level any of them needs.
+    void addSlot(GLuint texture, int slot);
+
+    // Stop streaming texture. Call before deleting it.
+    void release(GLuint texture);
+
+    // Call once per frame on the GL thread, before drawing. Binds this frame's feedback buffer.
+    void update();
+
+    // Bytes of resident levels to stay within, 0 (the default) for no limit
+    void setBudget(size_t bytes) { budget = bytes; }
+
+    // Bytes of other textures, which can't be evicted, to count against the budget
+    void setFixedBytes(size_t bytes) { fixedBytes = bytes; }
+
+    size_t residentBytes() const;
+    size_t fullBytes() const;           // What every texture would take fully resident
+
+    // Counts since the streamer was created, per texture and feedback frame for hits and misses
+    struct Stats {
+        unsigned long long hits;        // Drawn with every level it needed resident
+        unsigned long long misses;      // Drawn needing finer levels than were resident
+        int loadedLevels;               // Finer levels loaded
+        int reloadedLevels;             // Of those, levels evicted for the budget earlier
+        int evictedLevels;              // Dropped from the least recently drawn textures, for the budget
+        int releasedLevels;             // Dropped after going unused for evictFrames frames
+    };
+    const Stats & stats() const { return counts; }
+
+private:
+    struct Streamed {
+        std::string fName;
+        Texture::Options options;
+        Resident resident;
+        unsigned long long serial;      // Identifies the load, as texture names get reused
+        GLenum internalFormat;          // 0 until the tail arrives
+        int width, height;
+        int base;                       // Finest resident level
+        int tail;                       // Coarsest base, always resident
+        std::vector<size_t> levelBytes;
+        std::vector<int> slots;
+        bool loading;                   // Tail or finer levels on their way
+        int needed;                     // Finest level needed in the latest feedback
+        unsigned long long lastDrawn;   // Feedback frame it was last drawn in
+        uint32_t evictedMask;           // Levels evicted for the budget, one bit each
+        int coarserFrames;              // Frames in a row needing fewer levels than are resident
+        int wanted;                     // Finest level needed over those frames
+    };
+
+    struct Load {
+        GLuint texture;
+        unsigned long long serial;
+        size_t reserved;                // Budget held for the levels until they arrive
+        std::future<Texture::Data> data;
+    };
+
+    int slots, tailSize, evictFrames;
+    size_t frameBudget, budget, fixedBytes;
+    size_t reservedBytes;
+    GLuint buffers[FRAMES_IN_FLIGHT];
+    GLuint * requests[FRAMES_IN_FLIGHT];
+    GLsync fences[FRAMES_IN_FLIGHT];
+    int current;                        // Buffer bound for the frame being drawn
+    bool bound;
+    unsigned long long nextSerial;
+    std::map<GLuint, Streamed> textures;
+    std::vector<Load> loads;
+    unsigned long long feedbackFrame;
+    Stats counts;
+
+    void readFeedback(const GLuint * frameRequests);
+    void commit(Streamed & texture, GLuint name, Texture::Data & data);
+    void evict(Streamed & texture, GLuint name, int newBase);
+    bool makeRoom(size_t bytes);
+    size_t bytesFrom(const Streamed & texture, int level) const;
+};
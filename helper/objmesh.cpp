@@ -29,8 +29,19 @@ void ObjMesh::render() const {
     }
 }
 
+void ObjMesh::renderInstanced(const InstanceBuffer & instances) const {
+    if( drawAdj ) {
+        instances.bind();
+        glBindVertexArray(vao);
+        glDrawElementsInstanced(GL_TRIANGLES_ADJACENCY, nVerts, GL_UNSIGNED_INT, 0, instances.getCount());
+        glBindVertexArray(0);
+    } else {
+        TriangleMesh::renderInstanced(instances);
+    }
+}
 
-std::unique_ptr<ObjMesh> ObjMesh::load( const char * fileName, bool center, bool genTangents ) {
+
+std::unique_ptr<ObjMesh> ObjMesh::load( const char * fileName, bool center, bool genTangents, bool keepCollisionMesh ) {
 
     std::unique_ptr<ObjMesh> mesh(new ObjMesh());
 
@@ -47,6 +58,12 @@ std::unique_ptr<ObjMesh> ObjMesh::load( const char * fileName, bool center, bool
     GlMeshData glMesh;
     meshData.toGlMesh(glMesh);
 
+    // Collision mesh uses the OBJ's unique positions, rather than the GL vertices split by normal and tex coord
+    if( keepCollisionMesh ) {
+        glm::vec3 offset = center ? 0.5f * (mesh->bbox.max + mesh->bbox.min) : glm::vec3(0.0f);
+        mesh->collisionMesh = meshData.toCollisionMesh(offset);
+    }
+
     if( center ) glMesh.center(mesh->bbox);
 
     // Load into VAO
@@ -60,6 +77,9 @@ std::unique_ptr<ObjMesh> ObjMesh::load( const char * fileName, bool center, bool
          << " vertices = " << (glMesh.points.size() / 3)
          << " triangles = " << (glMesh.faces.size() / 3) 
 		 << endl << "    " << mesh->bbox.toString() << endl;
+    if( mesh->collisionMesh ) {
+        cout << "    Collision mesh: " << mesh->collisionMesh->memoryUsage() << " bytes" << endl;
+    }
 
     return mesh;
 }
@@ -320,6 +340,20 @@ void ObjMesh::ObjMeshData::toGlMesh(GlMeshData & data) {
     }
 }
 
+std::shared_ptr<const CollisionMesh> ObjMesh::ObjMeshData::toCollisionMesh(const glm::vec3 & offset) {
+    std::vector<vec3> pts(points.size());
+    for( size_t i = 0; i < points.size(); i++ ) {
+        pts[i] = points[i] - offset;
+    }
+
+    std::vector<GLuint> tris(faces.size());
+    for( size_t i = 0; i < faces.size(); i++ ) {
+        tris[i] = (GLuint)faces[i].pIdx;
+    }
+
+    return std::make_shared<const CollisionMesh>(pts, tris);
+}
+
 void ObjMesh::GlMeshData::convertFacesToAdjancencyFormat()
 {
     // Elements with adjacency info
@@ -3,6 +3,7 @@
 #include "trianglemesh.h"
 #include <glad/glad.h>
 #include "aabb.h"
+#include "collisionmesh.h"
 
 #include <vector>
 #include <glm/glm.hpp>
@@ -15,15 +16,24 @@ private:
     bool drawAdj;
 
 public:
-    static std::unique_ptr<ObjMesh> load(const char * fileName, bool center = false, bool genTangents = false);
+    // keepCollisionMesh retains a compact CPU copy of the geometry (see getCollisionMesh)
+    static std::unique_ptr<ObjMesh> load(const char * fileName, bool center = false, bool genTangents = false,
+                                         bool keepCollisionMesh = false);
     static std::unique_ptr<ObjMesh> loadWithAdjacency(const char * fileName, bool center = false);
 
     void render() const override;
 
+    // Null unless the mesh was loaded with keepCollisionMesh. The copy is shared, so it can
+    // outlive this mesh and be handed to every instance of it.
+    std::shared_ptr<const CollisionMesh> getCollisionMesh() const { return collisionMesh; }
+
+    void renderInstanced(const InstanceBuffer & instances) const override;
+
 protected:
     ObjMesh();
 
     Aabb bbox;
+    std::shared_ptr<const CollisionMesh> collisionMesh;
 
     // Helper classes used for loading
     class GlMeshData {
@@ -77,5 +87,6 @@ protected:
         void generateTangents();
         void load( const char * fileName, Aabb & bbox );
         void toGlMesh(GlMeshData & data);
+        std::shared_ptr<const CollisionMesh> toCollisionMesh(const glm::vec3 & offset);
     };
 };
@@ -65,5 +65,6 @@ Plane::Plane(float xsize, float zsize, int xdivs, int zdivs, float smax, float t
         }
     }
 
-    initBuffers(&el, &p, &n, &tex, &tang);
+    std::vector<GLubyte> verts = Layout::interleave(nPoints, p.data(), n.data(), tex.data(), tang.data());
+    initBuffers<Layout>(el.data(), (GLsizei)el.size(), verts.data(), nPoints);
 }
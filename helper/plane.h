@@ -5,5 +5,8 @@
 class Plane : public TriangleMesh
 {
 public:
+    using Layout = VertexLayout<Position3f, Normal3f, UV2f, Tangent4f>;
+
+    // Vertex (i, j) is row i along z and column j along x, at index i * (xdivs + 1) + j
     Plane(float xsize, float zsize, int xdivs, int zdivs, float smax = 1.0f, float tmax = 1.0f);
 };
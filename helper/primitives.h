@@ -0,0 +1,116 @@
+#pragma once
+
+#include <glad/glad.h>
+#include "vertexlayout.h"
+
+#include <array>
+#include <cstddef>
+
+// Fixed primitives baked at compile time. The arrays live in read-only static storage
+// and are uploaded from there, so nothing is built on the heap at startup.
+namespace Primitives {
+
+    // Corners of the 24 cube vertices, four per face: front, right, back, left, bottom, top
+    constexpr GLfloat cubeCorners[24][3] = {
+        // Front
+        { -1, -1,  1 }, {  1, -1,  1 }, {  1,  1,  1 }, { -1,  1,  1 },
+        // Right
+        {  1, -1,  1 }, {  1, -1, -1 }, {  1,  1, -1 }, {  1,  1,  1 },
+        // Back
+        { -1, -1, -1 }, { -1,  1, -1 }, {  1,  1, -1 }, {  1, -1, -1 },
+        // Left
+        { -1, -1,  1 }, { -1,  1,  1 }, { -1,  1, -1 }, { -1, -1, -1 },
+        // Bottom
+        { -1, -1,  1 }, { -1, -1, -1 }, {  1, -1, -1 }, {  1, -1,  1 },
+        // Top
+        { -1,  1,  1 }, {  1,  1,  1 }, {  1,  1, -1 }, { -1,  1, -1 }
+    };
+
+    constexpr GLfloat cubeFaceNormals[6][3] = {
+        { 0, 0, 1 }, { 1, 0, 0 }, { 0, 0, -1 }, { -1, 0, 0 }, { 0, -1, 0 }, { 0, 1, 0 }
+    };
+
+    // Tex coords of a face's four corners, as half floats (0x3c00 is 1.0)
+    constexpr GLushort cubeFaceTexCoords[4][2] = {
+        { 0, 0 }, { 0x3c00, 0 }, { 0x3c00, 0x3c00 }, { 0, 0x3c00 }
+    };
+
+    // Positions of a cube with the given side length, centred on the origin
+    template<int Side>
+    constexpr std::array<GLfloat, 72> makeCubePositions() {
+        std::array<GLfloat, 72> p{};
+        for( size_t v = 0; v < 24; v++ )
+            for( size_t c = 0; c < 3; c++ )
+                p[v*3 + c] = cubeCorners[v][c] * (Side * 0.5f);
+        return p;
+    }
+
+    // Two triangles per face, counter-clockwise seen from outside the cube, or from
+    // inside it when Inward is set (for a sky box)
+    template<bool Inward>
+    constexpr std::array<GLuint, 36> makeCubeElements() {
+        std::array<GLuint, 36> el{};
+        for( GLuint f = 0; f < 6; f++ ) {
+            GLuint base = f * 4;
+            GLuint tri[6] = { 0, 1, 2, 0, 2, 3 };
+            if( Inward ) {
+                tri[1] = 2; tri[2] = 1;
+                tri[4] = 3; tri[5] = 2;
+            }
+            for( size_t i = 0; i < 6; i++ ) el[f*6 + i] = base + tri[i];
+        }
+        return el;
+    }
+
+    // Matches VertexLayout<Position3f, Normal3f, UV2h>
+    struct CubeVertex {
+        GLfloat position[3];
+        GLfloat normal[3];
+        GLushort texCoord[2];
+    };
+
+    template<int Side>
+    constexpr std::array<CubeVertex, 24> makeCubeVertices() {
+        std::array<CubeVertex, 24> verts{};
+        std::array<GLfloat, 72> p = makeCubePositions<Side>();
+        for( size_t v = 0; v < 24; v++ ) {
+            for( size_t c = 0; c < 3; c++ ) {
+                verts[v].position[c] = p[v*3 + c];
+                verts[v].normal[c] = cubeFaceNormals[v / 4][c];
+            }
+            verts[v].texCoord[0] = cubeFaceTexCoords[v % 4][0];
+            verts[v].texCoord[1] = cubeFaceTexCoords[v % 4][1];
+        }
+        return verts;
+    }
+
+    template<int Side> inline constexpr std::array<CubeVertex, 24> cubeVertices = makeCubeVertices<Side>();
+    template<int Side> inline constexpr std::array<GLfloat, 72> cubePositions = makeCubePositions<Side>();
+    inline constexpr std::array<GLuint, 36> cubeElements = makeCubeElements<false>();
+    inline constexpr std::array<GLuint, 36> skyBoxElements = makeCubeElements<true>();
+
+    // Two triangles covering the screen in normalized device coordinates.
+    // Matches VertexLayout<Position3f, UV2f>.
+    struct QuadVertex {
+        GLfloat position[3];
+        GLfloat texCoord[2];
+    };
+
+    inline constexpr std::array<QuadVertex, 6> fullscreenQuad = {{
+        { { -1.0f, -1.0f, 0.0f }, { 0.0f, 0.0f } },
+        { {  1.0f, -1.0f, 0.0f }, { 1.0f, 0.0f } },
+        { {  1.0f,  1.0f, 0.0f }, { 1.0f, 1.0f } },
+        { { -1.0f, -1.0f, 0.0f }, { 0.0f, 0.0f } },
+        { {  1.0f,  1.0f, 0.0f }, { 1.0f, 1.0f } },
+        { { -1.0f,  1.0f, 0.0f }, { 0.0f, 1.0f } }
+    }};
+
+    using CubeLayout = VertexLayout<Position3f, Normal3f, UV2h>;
+    using QuadLayout = VertexLayout<Position3f, UV2f>;
+
+    static_assert(sizeof(CubeVertex) == CubeLayout::stride, "CubeVertex doesn't match its layout");
+    static_assert(offsetof(CubeVertex, normal) == CubeLayout::formats[1].offset, "CubeVertex doesn't match its layout");
+    static_assert(offsetof(CubeVertex, texCoord) == CubeLayout::formats[2].offset, "CubeVertex doesn't match its layout");
+    static_assert(sizeof(QuadVertex) == QuadLayout::stride, "QuadVertex doesn't match its layout");
+    static_assert(offsetof(QuadVertex, texCoord) == QuadLayout::formats[1].offset, "QuadVertex doesn't match its layout");
+}
@@ -2,11 +2,19 @@
 #define SKYBOX_H
 
 #include "trianglemesh.h"
+#include "primitives.h"
 
+// Cube seen from the inside. The vertices are baked at compile time for the given side length.
+template<int Size = 50>
 class SkyBox : public TriangleMesh
 {
 public:
-    SkyBox(float size = 50.0f);
+    SkyBox() {
+        // We don't shade a sky box, so positions are the only attribute
+        const auto & v = Primitives::cubePositions<Size>;
+        const auto & el = Primitives::skyBoxElements;
+        initBuffers<VertexLayout<Position3f>>(el.data(), (GLsizei)el.size(), v.data(), (GLsizei)(v.size() / 3));
+    }
 };
 
 
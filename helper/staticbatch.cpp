@@ -0,0 +1,93 @@
+#include "staticbatch.h"
+
+#include <iostream>
+using std::cout;
+using std::endl;
+
+using glm::vec3;
+using glm::vec4;
+using glm::mat3;
+
+namespace {
+    // Extend an optional attribute array to nPoints entries of the given default value
+    void padAttribute(std::vector<GLfloat> & attrib, size_t nPoints, const std::vector<GLfloat> & value) {
+        while( attrib.size() < nPoints * value.size() ) {
+            attrib.insert(attrib.end(), value.begin(), value.end());
+        }
+    }
+}
+
+StaticBatch::StaticBatch()
+{ }
+
+void StaticBatch::add(const TriangleMesh & mesh, const glm::mat4 & model) {
+    MeshData src;
+    mesh.readBack(src);
+    if( src.points.empty() ) return;
+
+    mat3 model3 = mat3(model);
+    mat3 normalMatrix = glm::transpose(glm::inverse(model3));
+
+    // A mirroring transform flips both the winding and the tangent frame's handedness
+    bool mirrored = glm::determinant(model3) < 0.0f;
+
+    size_t baseVertex = data.points.size() / 3;
+    size_t nPoints = src.points.size() / 3;
+
+    for( size_t i = 0; i < nPoints; i++ ) {
+        vec4 p = model * vec4(src.points[i*3], src.points[i*3+1], src.points[i*3+2], 1.0f);
+        data.points.push_back(p.x);
+        data.points.push_back(p.y);
+        data.points.push_back(p.z);
+        vec3 world(p);
+        bounds.add(world);
+
+        vec3 n(0.0f);
+        if( !src.normals.empty() )
+            n = glm::normalize(normalMatrix * vec3(src.normals[i*3], src.normals[i*3+1], src.normals[i*3+2]));
+        data.normals.push_back(n.x);
+        data.normals.push_back(n.y);
+        data.normals.push_back(n.z);
+    }
+
+    // Tex coords are copied as they are. Fill in a default for whichever side is missing them.
+    if( !src.texCoords.empty() || !data.texCoords.empty() ) {
+        padAttribute(data.texCoords, baseVertex, { 0.0f, 0.0f });
+        if( src.texCoords.empty() ) padAttribute(data.texCoords, baseVertex + nPoints, { 0.0f, 0.0f });
+        else data.texCoords.insert(data.texCoords.end(), src.texCoords.begin(), src.texCoords.end());
+    }
+
+    if( !src.tangents.empty() || !data.tangents.empty() ) {
+        padAttribute(data.tangents, baseVertex, { 1.0f, 0.0f, 0.0f, 1.0f });
+        if( src.tangents.empty() ) {
+            padAttribute(data.tangents, baseVertex + nPoints, { 1.0f, 0.0f, 0.0f, 1.0f });
+        } else {
+            for( size_t i = 0; i < nPoints; i++ ) {
+                vec3 t = glm::normalize(model3 * vec3(src.tangents[i*4], src.tangents[i*4+1], src.tangents[i*4+2]));
+                data.tangents.push_back(t.x);
+                data.tangents.push_back(t.y);
+                data.tangents.push_back(t.z);
+                data.tangents.push_back(mirrored ? -src.tangents[i*4+3] : src.tangents[i*4+3]);
+            }
+        }
+    }
+
+    for( size_t i = 0; i + 2 < src.indices.size(); i += 3 ) {
+        GLuint a = src.indices[i], b = src.indices[i+1], c = src.indices[i+2];
+        if( mirrored ) std::swap(b, c);
+        data.indices.push_back((GLuint)baseVertex + a);
+        data.indices.push_back((GLuint)baseVertex + b);
+        data.indices.push_back((GLuint)baseVertex + c);
+    }
+}
+
+void StaticBatch::build() {
+    cout << "Built static batch: vertices = " << (data.points.size() / 3)
+         << " triangles = " << (data.indices.size() / 3) << endl;
+
+    initBuffers(&data.indices, &data.points, &data.normals,
+            data.texCoords.empty() ? nullptr : &data.texCoords,
+            data.tangents.empty() ? nullptr : &data.tangents);
+
+    data = MeshData();
+}
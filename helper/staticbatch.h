@@ -0,0 +1,27 @@
+#pragma once
+
+#include "trianglemesh.h"
+#include "aabb.h"
+#include <glm/glm.hpp>
+
+// Meshes that never move and share a material, pre-transformed into world space
+// at load time and merged into one mesh so they can be drawn with a single call.
+// Render with an identity model matrix.
+class StaticBatch : public TriangleMesh
+{
+public:
+    StaticBatch();
+
+    // Append a copy of mesh, transformed by model. Only GL_TRIANGLES meshes can be batched.
+    void add(const TriangleMesh & mesh, const glm::mat4 & model);
+
+    // Upload everything added so far and release the CPU copy
+    void build();
+
+    // World space bounds of everything added, kept after build() for culling
+    const Aabb & getBounds() const { return bounds; }
+
+private:
+    MeshData data;
+    Aabb bounds;
+};
@@ -2,7 +2,17 @@
 #include "teapotdata.h"
 #include <glad/glad.h>
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <cstdio>
+#include <cstring>
+#include <thread>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define TEAPOT_SSE
+#include <xmmintrin.h>
+#endif
 
 #include <glm/gtc/matrix_transform.hpp>
 using glm::vec3;
@@ -22,7 +32,34 @@ Teapot::Teapot(int grid, const mat4 & lidTransform)
     generatePatches( p, n, tc, el, grid );
     moveLid(grid, p, lidTransform);
 
-    initBuffers(&el, &p, &n, &tc);
+    using Layout = VertexLayout<Position3f, Normal3f, UV2f>;
+    std::vector<GLubyte> vertData = Layout::interleave(verts, p.data(), n.data(), tc.data());
+    initBuffers<Layout>(el.data(), (GLsizei)el.size(), vertData.data(), verts);
+}
+
+std::vector<Teapot::PatchInstance> Teapot::patchInstances()
+{
+    const mat3 identity(1.0f);
+    const mat3 reflectX(vec3(-1.0f, 0.0f, 0.0f), vec3(0.0f, 1.0f, 0.0f), vec3(0.0f, 0.0f, 1.0f));
+    const mat3 reflectY(vec3(1.0f, 0.0f, 0.0f), vec3(0.0f, -1.0f, 0.0f), vec3(0.0f, 0.0f, 1.0f));
+    const mat3 reflectXY(vec3(-1.0f, 0.0f, 0.0f), vec3(0.0f, -1.0f, 0.0f), vec3(0.0f, 0.0f, 1.0f));
+
+    // Patches 0-5 (rim, body, lid and bottom) are reflected in x and y.
+    // Patches 6-9 (handle and spout) are only reflected in y.
+    std::vector<PatchInstance> insts;
+    for( int patchNum = 0; patchNum < 10; patchNum++ ) {
+        bool reflectInX = patchNum < 6;
+
+        // Patch without modification
+        insts.push_back({ patchNum, false, identity, true });
+        // Patch reflected in x
+        if( reflectInX ) insts.push_back({ patchNum, true, reflectX, false });
+        // Patch reflected in y
+        insts.push_back({ patchNum, true, reflectY, false });
+        // Patch reflected in x and y
+        if( reflectInX ) insts.push_back({ patchNum, false, reflectXY, true });
+    }
+    return insts;
 }
 
 void Teapot::generatePatches(
@@ -30,34 +67,86 @@ void Teapot::generatePatches(
         std::vector<GLfloat> & n,
         std::vector<GLfloat> & tc,
         std::vector<GLuint> & el,
-        int grid)
+        int grid, bool parallel)
 {
     std::vector<GLfloat> B(4*(grid+1));  // Pre-computed Bernstein basis functions
     std::vector<GLfloat> dB(4*(grid+1)); // Pre-computed derivitives of basis functions
 
-    int idx = 0, elIndex = 0, tcIndex = 0;
-
     // Pre-compute the basis functions  (Bernstein polynomials)
     // and their derivatives
     computeBasisFunctions(B, dB, grid);
 
-    // Build each patch
-    // The rim
-    buildPatchReflect(0, B, dB, p, n, tc, el, idx, elIndex, tcIndex, grid, true, true);
-    // The body
-    buildPatchReflect(1, B, dB, p, n, tc, el, idx, elIndex, tcIndex, grid, true, true);
-    buildPatchReflect(2, B, dB, p, n, tc, el, idx, elIndex, tcIndex, grid, true, true);
-    // The lid
-    buildPatchReflect(3, B, dB, p, n, tc, el, idx, elIndex, tcIndex, grid, true, true);
-    buildPatchReflect(4, B, dB, p, n, tc, el, idx, elIndex, tcIndex, grid, true, true);
-    // The bottom
-    buildPatchReflect(5, B, dB, p, n, tc, el, idx, elIndex, tcIndex, grid, true, true);
-    // The handle
-    buildPatchReflect(6, B, dB, p, n, tc, el, idx, elIndex, tcIndex, grid, false, true);
-    buildPatchReflect(7, B, dB, p, n, tc, el, idx, elIndex, tcIndex, grid, false, true);
-    // The spout
-    buildPatchReflect(8, B, dB, p, n, tc, el, idx, elIndex, tcIndex, grid, false, true);
-    buildPatchReflect(9, B, dB, p, n, tc, el, idx, elIndex, tcIndex, grid, false, true);
+    // Every patch has the same size, so each one's place in the output is known up front
+    std::vector<PatchInstance> insts = patchInstances();
+    int vertsPerPatch = (grid + 1) * (grid + 1);
+    int elsPerPatch = grid * grid * 6;
+
+    if( !parallel ) {
+        for( int k = 0; k < (int)insts.size(); k++ ) {
+            buildPatch(insts[k], B, dB, p, n, tc, el,
+                       k * vertsPerPatch * 3, k * elsPerPatch, k * vertsPerPatch * 2, grid);
+        }
+        return;
+    }
+
+    // Transposed copies of the tables, [basis][gridV], so four neighbouring grid points'
+    // values are contiguous. Padded with zeros to a whole number of groups of four.
+    int rowStride = (grid + 1 + 3) & ~3;
+    std::vector<GLfloat> BT(4 * rowStride, 0.0f), dBT(4 * rowStride, 0.0f);
+    for( int g = 0; g <= grid; g++ ) {
+        for( int b = 0; b < 4; b++ ) {
+            BT[b * rowStride + g] = B[g*4 + b];
+            dBT[b * rowStride + g] = dB[g*4 + b];
+        }
+    }
+
+    std::atomic<int> nextPatch(0);
+    auto worker = [&]() {
+        for( int k = nextPatch++; k < (int)insts.size(); k = nextPatch++ ) {
+            buildPatchVectorized(insts[k], B, dB, BT, dBT, p, n, tc, el,
+                                 k * vertsPerPatch * 3, k * elsPerPatch, k * vertsPerPatch * 2, grid);
+        }
+    };
+
+    int nThreads = std::max(1, std::min((int)std::thread::hardware_concurrency(), (int)insts.size()));
+    std::vector<std::thread> threads;
+    for( int t = 1; t < nThreads; t++ ) threads.emplace_back(worker);
+    worker();
+    for( std::thread & t : threads ) t.join();
+}
+
+void Teapot::benchmark()
+{
+    const int grids[] = { 8, 16, 32, 64, 128, 256 };
+
+    printf("Teapot generation: grid, serial ms, parallel ms, speedup, identical\n");
+    for( int grid : grids ) {
+        int verts = 32 * (grid + 1) * (grid + 1);
+        int faces = grid * grid * 32;
+        std::vector<GLfloat> p[2], n[2], tc[2];
+        std::vector<GLuint> el[2];
+        double ms[2];
+
+        for( int run = 0; run < 2; run++ ) {
+            p[run].resize(verts * 3);
+            n[run].resize(verts * 3);
+            tc[run].resize(verts * 2);
+            el[run].resize(faces * 6);
+
+            auto start = std::chrono::steady_clock::now();
+            generatePatches(p[run], n[run], tc[run], el[run], grid, run == 1);
+            ms[run] = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        }
+
+        // Compare bits rather than values, so signed zeros and NaNs must match too
+        bool identical =
+            std::memcmp(p[0].data(), p[1].data(), p[0].size() * sizeof(GLfloat)) == 0 &&
+            std::memcmp(n[0].data(), n[1].data(), n[0].size() * sizeof(GLfloat)) == 0 &&
+            std::memcmp(tc[0].data(), tc[1].data(), tc[0].size() * sizeof(GLfloat)) == 0 &&
+            el[0] == el[1];
+
+        printf("%4d %10.2f %10.2f %7.2fx %s\n", grid, ms[0], ms[1], ms[0] / ms[1], identical ? "yes" : "NO");
+    }
 }
 
 void Teapot::moveLid(int grid, std::vector<GLfloat> & p, const mat4 & lidTransform) {
@@ -75,54 +164,15 @@ void Teapot::moveLid(int grid, std::vector<GLfloat> & p, const mat4 & lidTransfo
     }
 }
 
-void Teapot::buildPatchReflect(int patchNum,
-                               std::vector<GLfloat> & B, std::vector<GLfloat> & dB,
-                               std::vector<GLfloat> & v, std::vector<GLfloat> & n,
-                               std::vector<GLfloat> & tc, std::vector<GLuint> & el,
-                               int &index, int &elIndex, int &tcIndex, int grid,
-                               bool reflectX, bool reflectY)
-{
-    vec3 patch[4][4];
-    vec3 patchRevV[4][4];
-    getPatch(patchNum, patch, false);
-    getPatch(patchNum, patchRevV, true);
-
-    // Patch without modification
-    buildPatch(patch, B, dB, v, n, tc, el,
-               index, elIndex, tcIndex, grid, mat3(1.0f), true);
-
-    // Patch reflected in x
-    if( reflectX ) {
-        buildPatch(patchRevV, B, dB, v, n, tc, el,
-                   index, elIndex, tcIndex, grid, mat3(vec3(-1.0f, 0.0f, 0.0f),
-                                              vec3(0.0f, 1.0f, 0.0f),
-                                              vec3(0.0f, 0.0f, 1.0f) ), false );
-    }
-
-    // Patch reflected in y
-    if( reflectY ) {
-        buildPatch(patchRevV, B, dB, v, n, tc, el,
-                   index, elIndex, tcIndex, grid, mat3(vec3(1.0f, 0.0f, 0.0f),
-                                              vec3(0.0f, -1.0f, 0.0f),
-                                              vec3(0.0f, 0.0f, 1.0f) ), false );
-    }
-
-    // Patch reflected in x and y
-    if( reflectX && reflectY ) {
-        buildPatch(patch, B, dB, v, n, tc, el,
-                   index, elIndex, tcIndex, grid, mat3(vec3(-1.0f, 0.0f, 0.0f),
-                                              vec3(0.0f, -1.0f, 0.0f),
-                                              vec3(0.0f, 0.0f, 1.0f) ), true );
-    }
-}
-
-void Teapot::buildPatch(vec3 patch[][4],
-                        std::vector<GLfloat> & B, std::vector<GLfloat> & dB,
+void Teapot::buildPatch(const PatchInstance & inst,
+                        const std::vector<GLfloat> & B, const std::vector<GLfloat> & dB,
                         std::vector<GLfloat> & v, std::vector<GLfloat> & n,
                         std::vector<GLfloat> & tc, std::vector<GLuint> & el,
-                        int &index, int &elIndex, int &tcIndex, int grid, mat3 reflect,
-                        bool invertNormal)
+                        int index, int elIndex, int tcIndex, int grid)
 {
+    vec3 patch[4][4];
+    getPatch(inst.patchNum, patch, inst.reverseV);
+
     int startIndex = index / 3;
     float tcFactor = 1.0f / grid;
 
@@ -130,9 +180,9 @@ void Teapot::buildPatch(vec3 patch[][4],
     {
         for( int j = 0 ; j <= grid; j++)
         {
-            vec3 pt = reflect * evaluate(i,j,B,patch);
-            vec3 norm = reflect * evaluateNormal(i,j,B,dB,patch);
-            if( invertNormal )
+            vec3 pt = inst.reflect * evaluate(i,j,B,patch);
+            vec3 norm = inst.reflect * evaluateNormal(i,j,B,dB,patch);
+            if( inst.invertNormal )
                 norm = -norm;
 
             v[index] = pt.x;
@@ -151,6 +201,97 @@ void Teapot::buildPatch(vec3 patch[][4],
         }
     }
 
+    buildPatchElements(el, startIndex, elIndex, grid);
+}
+
+// Same as buildPatch, but the sums over the control points are done for four grid points
+// (along v) at once. Each lane performs exactly the same float operations in the same order
+// as evaluate/evaluateNormal, so the results are bit-identical. The reflection and
+// normalization are done per point with the scalar code.
+void Teapot::buildPatchVectorized(const PatchInstance & inst,
+                                  const std::vector<GLfloat> & B, const std::vector<GLfloat> & dB,
+                                  const std::vector<GLfloat> & BT, const std::vector<GLfloat> & dBT,
+                                  std::vector<GLfloat> & v, std::vector<GLfloat> & n,
+                                  std::vector<GLfloat> & tc, std::vector<GLuint> & el,
+                                  int index, int elIndex, int tcIndex, int grid)
+{
+#ifndef TEAPOT_SSE
+    buildPatch(inst, B, dB, v, n, tc, el, index, elIndex, tcIndex, grid);
+#else
+    vec3 patch[4][4];
+    getPatch(inst.patchNum, patch, inst.reverseV);
+
+    int startIndex = index / 3;
+    int rowStride = (int)BT.size() / 4;
+    float tcFactor = 1.0f / grid;
+
+    for( int i = 0; i <= grid; i++ )
+    {
+        for( int j0 = 0; j0 <= grid; j0 += 4 )
+        {
+            __m128 px = _mm_setzero_ps(), py = _mm_setzero_ps(), pz = _mm_setzero_ps();
+            __m128 dux = _mm_setzero_ps(), duy = _mm_setzero_ps(), duz = _mm_setzero_ps();
+            __m128 dvx = _mm_setzero_ps(), dvy = _mm_setzero_ps(), dvz = _mm_setzero_ps();
+
+            for( int a = 0; a < 4; a++ ) {
+                for( int b = 0; b < 4; b++ ) {
+                    // patch * B(u) and patch * dB(u) are shared by all four lanes
+                    vec3 pB = patch[a][b] * B[i*4+a];
+                    vec3 pdB = patch[a][b] * dB[i*4+a];
+                    __m128 bv = _mm_loadu_ps(&BT[b * rowStride + j0]);
+                    __m128 dbv = _mm_loadu_ps(&dBT[b * rowStride + j0]);
+
+                    px = _mm_add_ps(px, _mm_mul_ps(_mm_set1_ps(pB.x), bv));
+                    py = _mm_add_ps(py, _mm_mul_ps(_mm_set1_ps(pB.y), bv));
+                    pz = _mm_add_ps(pz, _mm_mul_ps(_mm_set1_ps(pB.z), bv));
+
+                    dux = _mm_add_ps(dux, _mm_mul_ps(_mm_set1_ps(pdB.x), bv));
+                    duy = _mm_add_ps(duy, _mm_mul_ps(_mm_set1_ps(pdB.y), bv));
+                    duz = _mm_add_ps(duz, _mm_mul_ps(_mm_set1_ps(pdB.z), bv));
+
+                    dvx = _mm_add_ps(dvx, _mm_mul_ps(_mm_set1_ps(pB.x), dbv));
+                    dvy = _mm_add_ps(dvy, _mm_mul_ps(_mm_set1_ps(pB.y), dbv));
+                    dvz = _mm_add_ps(dvz, _mm_mul_ps(_mm_set1_ps(pB.z), dbv));
+                }
+            }
+
+            float lanes[9][4];
+            _mm_storeu_ps(lanes[0], px);  _mm_storeu_ps(lanes[1], py);  _mm_storeu_ps(lanes[2], pz);
+            _mm_storeu_ps(lanes[3], dux); _mm_storeu_ps(lanes[4], duy); _mm_storeu_ps(lanes[5], duz);
+            _mm_storeu_ps(lanes[6], dvx); _mm_storeu_ps(lanes[7], dvy); _mm_storeu_ps(lanes[8], dvz);
+
+            // The last group can run past the end of the row. Those lanes are dropped.
+            for( int l = 0; l < 4 && j0 + l <= grid; l++ )
+            {
+                vec3 pt = inst.reflect * vec3(lanes[0][l], lanes[1][l], lanes[2][l]);
+                vec3 norm = inst.reflect * normalFromDerivatives(
+                    vec3(lanes[3][l], lanes[4][l], lanes[5][l]), vec3(lanes[6][l], lanes[7][l], lanes[8][l]));
+                if( inst.invertNormal )
+                    norm = -norm;
+
+                v[index] = pt.x;
+                v[index+1] = pt.y;
+                v[index+2] = pt.z;
+
+                n[index] = norm.x;
+                n[index+1] = norm.y;
+                n[index+2] = norm.z;
+
+                tc[tcIndex] = i * tcFactor;
+                tc[tcIndex+1] = (j0 + l) * tcFactor;
+
+                index += 3;
+                tcIndex += 2;
+            }
+        }
+    }
+
+    buildPatchElements(el, startIndex, elIndex, grid);
+#endif
+}
+
+void Teapot::buildPatchElements(std::vector<GLuint> & el, int startIndex, int elIndex, int grid)
+{
     for( int i = 0; i < grid; i++ )
     {
         int iStart = i * (grid+1) + startIndex;
@@ -213,7 +354,7 @@ void Teapot::computeBasisFunctions( std::vector<GLfloat> & B, std::vector<GLfloa
 }
 
 
-vec3 Teapot::evaluate( int gridU, int gridV, std::vector<GLfloat> & B, vec3 patch[][4] )
+vec3 Teapot::evaluate( int gridU, int gridV, const std::vector<GLfloat> & B, vec3 patch[][4] )
 {
     vec3 p(0.0f,0.0f,0.0f);
     for( int i = 0; i < 4; i++) {
@@ -224,7 +365,7 @@ vec3 Teapot::evaluate( int gridU, int gridV, std::vector<GLfloat> & B, vec3 patc
     return p;
 }
 
-vec3 Teapot::evaluateNormal( int gridU, int gridV, std::vector<GLfloat> & B, std::vector<GLfloat> & dB, vec3 patch[][4] )
+vec3 Teapot::evaluateNormal( int gridU, int gridV, const std::vector<GLfloat> & B, const std::vector<GLfloat> & dB, vec3 patch[][4] )
 {
     vec3 du(0.0f,0.0f,0.0f);
     vec3 dv(0.0f,0.0f,0.0f);
@@ -236,6 +377,11 @@ vec3 Teapot::evaluateNormal( int gridU, int gridV, std::vector<GLfloat> & B, std
         }
     }
 
+    return normalFromDerivatives(du, dv);
+}
+
+vec3 Teapot::normalFromDerivatives( const vec3 & du, const vec3 & dv )
+{
     vec3 norm = glm::cross(du, dv);
     if (glm::length(norm) != 0.0f) {
         norm = glm::normalize(norm);
@@ -3,34 +3,56 @@
 #include "trianglemesh.h"
 #include <glm/glm.hpp>
 
+#include <vector>
+
 class Teapot : public TriangleMesh
 {
+    friend class TeapotPatches; // Shares the patch data and reflections
+
 private:
     //unsigned int faces;
 
-    void generatePatches(std::vector<GLfloat> & p,
-                         std::vector<GLfloat> & n,
-                         std::vector<GLfloat> & tc,
-                         std::vector<GLuint> & el, int grid);
-    void buildPatchReflect(int patchNum,
-                           std::vector<GLfloat> & B, std::vector<GLfloat> & dB,
+    // One of the 32 patches making up the teapot: a patch from the data, possibly reflected
+    struct PatchInstance {
+        int patchNum;
+        bool reverseV;
+        glm::mat3 reflect;
+        bool invertNormal;
+    };
+
+    static std::vector<PatchInstance> patchInstances();
+    static void buildPatch(const PatchInstance & inst,
+                           const std::vector<GLfloat> & B, const std::vector<GLfloat> & dB,
                            std::vector<GLfloat> & v, std::vector<GLfloat> & n,
                            std::vector<GLfloat> & tc, std::vector<GLuint> & el,
-                           int &index, int &elIndex, int &tcIndex, int grid,
-                           bool reflectX, bool reflectY);
-    void buildPatch(glm::vec3 patch[][4],
-                    std::vector<GLfloat> & B, std::vector<GLfloat> & dB,
-                    std::vector<GLfloat> & v, std::vector<GLfloat> & n,
-                    std::vector<GLfloat> & tc, std::vector<GLuint> & el,
-                    int &index, int &elIndex, int &tcIndex, int grid, glm::mat3 reflect,
-                    bool invertNormal);
-    void getPatch( int patchNum, glm::vec3 patch[][4], bool reverseV );
-
-    void computeBasisFunctions( std::vector<GLfloat> & B, std::vector<GLfloat> & dB, int grid );
-    glm::vec3 evaluate( int gridU, int gridV, std::vector<GLfloat> & B, glm::vec3 patch[][4] );
-    glm::vec3 evaluateNormal(  int gridU, int gridV, std::vector<GLfloat> & B, std::vector<GLfloat> & dB, glm::vec3 patch[][4] );
+                           int index, int elIndex, int tcIndex, int grid);
+    static void buildPatchVectorized(const PatchInstance & inst,
+                                     const std::vector<GLfloat> & B, const std::vector<GLfloat> & dB,
+                                     const std::vector<GLfloat> & BT, const std::vector<GLfloat> & dBT,
+                                     std::vector<GLfloat> & v, std::vector<GLfloat> & n,
+                                     std::vector<GLfloat> & tc, std::vector<GLuint> & el,
+                                     int index, int elIndex, int tcIndex, int grid);
+    static void buildPatchElements(std::vector<GLuint> & el, int startIndex, int elIndex, int grid);
+    static void getPatch( int patchNum, glm::vec3 patch[][4], bool reverseV );
+
+    static void computeBasisFunctions( std::vector<GLfloat> & B, std::vector<GLfloat> & dB, int grid );
+    static glm::vec3 evaluate( int gridU, int gridV, const std::vector<GLfloat> & B, glm::vec3 patch[][4] );
+    static glm::vec3 evaluateNormal( int gridU, int gridV, const std::vector<GLfloat> & B, const std::vector<GLfloat> & dB, glm::vec3 patch[][4] );
+    static glm::vec3 normalFromDerivatives( const glm::vec3 & du, const glm::vec3 & dv );
     void moveLid(int grid, std::vector<GLfloat> & p, const glm::mat4 & lidTransform);
 
 public:
     Teapot(int grid, const glm::mat4& lidTransform);
+
+    // Fills in the vertex data for all 32 patches. The parallel version builds patches on
+    // worker threads and evaluates four grid points at a time, with output identical to
+    // the serial version.
+    static void generatePatches(std::vector<GLfloat> & p,
+                                std::vector<GLfloat> & n,
+                                std::vector<GLfloat> & tc,
+                                std::vector<GLuint> & el, int grid, bool parallel = true);
+
+    // Times serial against parallel generation for a range of grid sizes and checks the
+    // results match. Doesn't need a GL context.
+    static void benchmark();
 };
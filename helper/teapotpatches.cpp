@@ -0,0 +1,60 @@
+#include "teapotpatches.h"
+#include "teapot.h"
+#include "vertexlayout.h"
+
+#include <vector>
+
+using glm::vec3;
+using glm::vec4;
+
+TeapotPatches::TeapotPatches(const glm::mat4 & lidTransform) : vao(0), vbo(0)
+{
+    // Same patches, reflections and control point order as the CPU generated Teapot.
+    // Reflections and the lid transform are affine, so they can be applied to the control
+    // points rather than the evaluated surface.
+    std::vector<Teapot::PatchInstance> insts = Teapot::patchInstances();
+    std::vector<GLfloat> points;
+    points.reserve(insts.size() * VERTICES_PER_PATCH * 3);
+
+    for( size_t k = 0; k < insts.size(); k++ ) {
+        vec3 patch[4][4];
+        Teapot::getPatch(insts[k].patchNum, patch, insts[k].reverseV);
+
+        // Instances 12 to 19 are the lid (patches 3 and 4)
+        bool lid = k >= 12 && k < 20;
+
+        for( int u = 0; u < 4; u++ ) {
+            for( int v = 0; v < 4; v++ ) {
+                vec3 p = insts[k].reflect * patch[u][v];
+                if( lid ) p = vec3(lidTransform * vec4(p, 1.0f));
+                points.push_back(p.x);
+                points.push_back(p.y);
+                points.push_back(p.z);
+            }
+        }
+    }
+
+    glGenBuffers(1, &vbo);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    glBufferData(GL_ARRAY_BUFFER, points.size() * sizeof(GLfloat), points.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    using Layout = VertexLayout<Position3f>;
+    glGenVertexArrays(1, &vao);
+    glBindVertexArray(vao);
+    glBindVertexBuffer(0, vbo, 0, Layout::stride);
+    Layout::apply(0);
+    glBindVertexArray(0);
+}
+
+TeapotPatches::~TeapotPatches() {
+    if( vbo != 0 ) glDeleteBuffers(1, &vbo);
+    if( vao != 0 ) glDeleteVertexArrays(1, &vao);
+}
+
+void TeapotPatches::render() const {
+    glPatchParameteri(GL_PATCH_VERTICES, VERTICES_PER_PATCH);
+    glBindVertexArray(vao);
+    glDrawArrays(GL_PATCHES, 0, NUM_PATCHES * VERTICES_PER_PATCH);
+    glBindVertexArray(0);
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include "drawable.h"
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+// The teapot as its 32 bicubic Bezier patches, drawn as GL_PATCHES of 16 control points
+// for the tessellation shaders to evaluate (see shader/teapot.tcs and teapot.tes). Only
+// 512 vertices are uploaded, and the tessellation level can follow the on-screen size
+// rather than being fixed by a grid. Produces the same surface as Teapot.
+class TeapotPatches : public Drawable
+{
+public:
+    TeapotPatches(const glm::mat4 & lidTransform);
+    ~TeapotPatches();
+
+    TeapotPatches(const TeapotPatches &) = delete;
+    TeapotPatches & operator=(const TeapotPatches &) = delete;
+
+    void render() const override;
+
+    static const GLint VERTICES_PER_PATCH = 16;
+    static const GLsizei NUM_PATCHES = 32;
+
+private:
+    GLuint vao, vbo;
+};
@@ -1,104 +1,572 @@
 #include "texture.h"
 #include "stb/stb_image.h"
+#include "stb/stb_image_write.h"
 #include "glutils.h"
+#include "ktx2.h"
+#include "hdrencode.h"
+#include "hdrfile.h"
+#include "equirect.h"
+#include "threadpool.h"
 
-/*static*/
-GLuint Texture::loadTexture( const std::string & fName ) {
-    int width, height;
-    unsigned char * data = Texture::loadPixels(fName, width, height);
-	GLuint tex = 0;
-    if( data != nullptr ) {
-        glGenTextures(1, &tex);
-        glBindTexture(GL_TEXTURE_2D, tex);
-        glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA8, width, height);
-        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, data);
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <iostream>
+#include <vector>
+
+namespace {
+    BlockCompression::Format blockFormat( Texture::Compression compression ) {
+        switch( compression ) {
+            case Texture::Compression::BC4: return BlockCompression::Format::BC4;
+            case Texture::Compression::BC5: return BlockCompression::Format::BC5;
+            default: return BlockCompression::Format::BC7;
+        }
+    }
+
+    // Where the cooked copy of fName lives, e.g. textures/albedo.png -> textures/albedo.bc7.ktx2
+    std::string cookedPath( const std::string & fName, const Texture::Options & options ) {
+        std::filesystem::path path(fName);
+        std::string suffix = (options.compression == Texture::Compression::BC4) ? ".bc4" :
+                             (options.compression == Texture::Compression::BC5) ? ".bc5" : ".bc7";
+        if( options.mipFilter == MipMap::Filter::Kaiser ) suffix += "-kaiser";
+        return path.replace_extension(suffix + ".ktx2").string();
+    }
+
+    bool isUpToDate( const std::string & cooked, const std::string & source ) {
+        std::error_code ec;
+        if( !std::filesystem::exists(cooked, ec) ) return false;
+        if( !std::filesystem::exists(source, ec) ) return true;   // Shipped without its source
+        return std::filesystem::last_write_time(cooked, ec) >= std::filesystem::last_write_time(source, ec);
+    }
+
+    // Encode the image and each of its mips into a KTX2 file
+    bool cook( const std::string & fName, const std::string & cooked, const Texture::Options & options,
+               Ktx2::Image & image, std::string & message ) {
+        int width, height;
+        unsigned char * data = Texture::loadPixels(fName, width, height);
+        if( data == nullptr ) return false;
 
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        BlockCompression::Format format = blockFormat(options.compression);
+        std::vector<MipMap::Level> mips = MipMap::generate(data, width, height, options.mipFilter, options.srgb);
 
+        image.vkFormat = (format == BlockCompression::Format::BC4) ? Ktx2::VK_FORMAT_BC4_UNORM_BLOCK :
+                         (format == BlockCompression::Format::BC5) ? Ktx2::VK_FORMAT_BC5_UNORM_BLOCK :
+                         options.srgb ? Ktx2::VK_FORMAT_BC7_SRGB_BLOCK : Ktx2::VK_FORMAT_BC7_UNORM_BLOCK;
+        image.width = width;
+        image.height = height;
+        image.levels.clear();
+        image.levels.push_back(BlockCompression::encode(data, width, height, format));
+        for( const MipMap::Level & mip : mips ) {
+            image.levels.push_back(BlockCompression::encode(mip.texels.data(), mip.width, mip.height, format));
+        }
         Texture::deletePixels(data);
+
+        if( Ktx2::write(cooked, image) ) {
+            message += "Cooked " + fName + " to " + cooked + "\n";
+        } else {
+            message += "Unable to write cooked texture " + cooked + "\n";
+        }
+        return true;
+    }
+
+    // First level of image no larger than maxSize, or 0 for no limit
+    int levelWithin( const Ktx2::Image & image, int maxSize ) {
+        int level = 0;
+        while( maxSize > 0 && level + 1 < (int)image.levels.size() &&
+               std::max(image.width >> level, image.height >> level) > maxSize ) {
+            level++;
+        }
+        return level;
+    }
+
+    // A cooked 2D image as texture data, with levels before baseLevel left empty
+    void setCompressedImage( Texture::Data & tex, Ktx2::Image & image, int baseLevel ) {
+        tex.internalFormat = (image.vkFormat == Ktx2::VK_FORMAT_BC4_UNORM_BLOCK) ? GL_COMPRESSED_RED_RGTC1 :
+                             (image.vkFormat == Ktx2::VK_FORMAT_BC5_UNORM_BLOCK) ? GL_COMPRESSED_RG_RGTC2 :
+                             (image.vkFormat == Ktx2::VK_FORMAT_BC7_SRGB_BLOCK) ? GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM :
+                             GL_COMPRESSED_RGBA_BPTC_UNORM;
+        tex.width = image.width;
+        tex.height = image.height;
+        tex.levels = (int)image.levels.size();
+        tex.baseLevel = baseLevel;
+        tex.images = std::move(image.levels);
+    }
+
+    void setHdrFormat( Texture::Data & tex, Texture::HdrFormat format ) {
+        switch( format ) {
+            case Texture::HdrFormat::RGB32F:
+                tex.internalFormat = GL_RGB32F;
+                tex.format = GL_RGB;
+                tex.type = GL_FLOAT;
+                break;
+            case Texture::HdrFormat::RGB16F:
+                tex.internalFormat = GL_RGB16F;
+                tex.format = GL_RGBA;
+                tex.type = GL_HALF_FLOAT;
+                break;
+            case Texture::HdrFormat::RGB9E5:
+                tex.internalFormat = GL_RGB9_E5;
+                tex.format = GL_RGB;
+                tex.type = GL_UNSIGNED_INT_5_9_9_9_REV;
+                break;
+        }
+    }
+
+    uint32_t hdrVkFormat( Texture::HdrFormat format ) {
+        switch( format ) {
+            case Texture::HdrFormat::RGB16F: return Ktx2::VK_FORMAT_R16G16B16A16_SFLOAT;
+            case Texture::HdrFormat::RGB9E5: return Ktx2::VK_FORMAT_E5B9G9R9_UFLOAT_PACK32;
+            default: return Ktx2::VK_FORMAT_R32G32B32_SFLOAT;
+        }
+    }
+
+    size_t hdrTexelBytes( Texture::HdrFormat format ) {
+        return (format == Texture::HdrFormat::RGB32F) ? 12 : (format == Texture::HdrFormat::RGB16F) ? 8 : 4;
+    }
+
+    // How far a converted cube map is from its float source, as a line for the load message
+    std::string conversionReport( const std::string & name, Texture::HdrFormat format, const Texture::Data & tex,
+                                  const HdrEncode::Error * faceErrors ) {
+        HdrEncode::Error error;
+        for( int face = 0; face < 6; face++ ) error.merge(faceErrors[face]);
+        size_t floatBytes = (size_t)tex.width * tex.height * 3 * sizeof(float) * tex.faces();
+
+        char report[160];
+        snprintf(report, sizeof(report), " (%zu KB, %zu KB as RGB32F), error relative to brightest channel: mean %.3g%%, max %.3g%%\n",
+                 tex.storageBytes() / 1024, floatBytes / 1024, error.mean() * 100.0, error.max * 100.0);
+        return "Converted " + name + " to " + Texture::hdrFormatName(format) + report;
+    }
+
+    // Where the cube map resampled from an equirectangular image is cached,
+    // e.g. skies/field.hdr -> skies/field.cube1024.rgb9_e5.ktx2
+    std::string equirectCachePath( const std::string & fName, int faceSize, Texture::HdrFormat format ) {
+        std::string formatName = Texture::hdrFormatName(format);
+        std::transform(formatName.begin(), formatName.end(), formatName.begin(), [](char c) { return (char)tolower(c); });
+        std::filesystem::path path(fName);
+        return path.replace_extension(".cube" + std::to_string(faceSize) + "." + formatName + ".ktx2").string();
+    }
+
+    // Decode the six faces of a cube map into data, one level each. decode(face, name, w, h, image)
+    // fills in one face, returning false if it couldn't be loaded.
+    template <typename Decode>
+    void prepareFaces( Texture::Data & data, const std::string & baseName, const std::string & extension,
+                       bool parallel, Decode decode ) {
+        const char * suffixes[] = { "posx", "negx", "posy", "negy", "posz", "negz" };
+
+        auto decodeFace = [&](int face) {
+            std::string texName = baseName + "_" + suffixes[face] + extension;
+            int w = 0, h = 0;
+            if( !decode(face, texName, w, h, data.images[face]) ) {
+                data.images[face].clear();
+                w = h = 0;
+            }
+            return std::make_pair(w, h);
+        };
+
+        data.target = GL_TEXTURE_CUBE_MAP;
+        data.levels = 1;
+        data.images.assign(6, std::vector<unsigned char>());
+
+        std::future<std::pair<int, int>> jobs[6];
+        for( int face = 0; face < 6; face++ ) {
+            if( parallel ) jobs[face] = ThreadPool::shared().submit([&decodeFace, face]() { return decodeFace(face); });
+        }
+        for( int face = 0; face < 6; face++ ) {
+            std::pair<int, int> size = parallel ? jobs[face].get() : decodeFace(face);
+
+            // Storage is sized from the first face
+            if( face == 0 ) {
+                data.width = size.first;
+                data.height = size.second;
+            }
+        }
+    }
+}
+
+/*static*/
+Texture::Data Texture::prepareTexture( const std::string & fName, const Options & options, int maxSize ) {
+    Data tex;
+
+    if( options.compression != Compression::None ) {
+        std::string cooked = cookedPath(fName, options);
+        Ktx2::Image image;
+        int firstLevel = 0;
+        bool loaded = false;
+        if( isUpToDate(cooked, fName) ) {
+            if( maxSize > 0 && Ktx2::read(cooked, image, 0, 0) ) firstLevel = levelWithin(image, maxSize);
+            loaded = Ktx2::read(cooked, image, firstLevel);
+        }
+        if( !loaded ) {
+            if( !cook(fName, cooked, options, image, tex.message) ) return tex;
+            firstLevel = levelWithin(image, maxSize);
+            for( int i = 0; i < firstLevel; i++ ) image.levels[i] = std::vector<unsigned char>();
+        }
+        setCompressedImage(tex, image, firstLevel);
+
+        size_t bytes = 0, uncompressed = 0;
+        for( int i = firstLevel; i < tex.levels; i++ ) {
+            bytes += tex.images[i].size();
+            uncompressed += (size_t)std::max(1, tex.width >> i) * std::max(1, tex.height >> i) * 4;
+        }
+        tex.message += "Loaded " + cooked + " (" + std::to_string(bytes / 1024) + " KB, " +
+                       std::to_string(uncompressed / 1024) + " KB as RGBA8" +
+                       (firstLevel > 0 ? ", from level " + std::to_string(firstLevel) : "") + ")\n";
+        return tex;
     }
 
+    unsigned char * data = Texture::loadPixels(fName, tex.width, tex.height);
+    if( data == nullptr ) return tex;
+
+    std::vector<MipMap::Level> mips = MipMap::generate(data, tex.width, tex.height, options.mipFilter, options.srgb);
+    tex.internalFormat = options.srgb ? GL_SRGB8_ALPHA8 : GL_RGBA8;
+    tex.format = GL_RGBA;
+    tex.type = GL_UNSIGNED_BYTE;
+    tex.levels = (int)mips.size() + 1;
+    tex.images.emplace_back(data, data + (size_t)tex.width * tex.height * 4);
+    for( MipMap::Level & mip : mips ) tex.images.push_back(std::move(mip.texels));
+    Texture::deletePixels(data);
     return tex;
 }
 
-void Texture::deletePixels(unsigned char *data) {
-    stbi_image_free(data);
+/*static*/
+Texture::Data Texture::prepareLevels( const std::string & fName, const Options & options, int firstLevel, int endLevel ) {
+    Data tex;
+    std::string cooked = cookedPath(fName, options);
+    Ktx2::Image image;
+    if( options.compression == Compression::None || !isUpToDate(cooked, fName) ||
+        !Ktx2::read(cooked, image, firstLevel, endLevel) ) {
+        return tex;
+    }
+    setCompressedImage(tex, image, firstLevel);
+    return tex;
 }
 
-unsigned char *Texture::loadPixels(const std::string &fName, int & width, int & height, bool flip) {
-    int bytesPerPix;
-    stbi_set_flip_vertically_on_load(flip);
-    unsigned char *data = stbi_load(fName.c_str(), &width, &height, &bytesPerPix, 4);
-    return data;
+/*static*/
+bool Texture::packOrm( const std::string & ao, const std::string & roughness, const std::string & metallic,
+                       const std::string & packedName ) {
+    const std::string * sources[] = { &ao, &roughness, &metallic };
+    bool upToDate = true;
+    for( const std::string * source : sources ) upToDate &= isUpToDate(packedName, *source);
+    if( upToDate ) return true;
+
+    // Rows stay in file order, as the packed image is flipped when it loads like any other
+    int widths[3], heights[3];
+    unsigned char * maps[3];
+    int width = 0, height = 0;
+    bool loaded = true;
+    for( int i = 0; i < 3; i++ ) {
+        maps[i] = loadPixels(*sources[i], widths[i], heights[i], false);
+        if( maps[i] == nullptr ) {
+            std::cerr << "Unable to pack " << packedName << ": can't load " << *sources[i] << std::endl;
+            loaded = false;
+            continue;
+        }
+        width = std::max(width, widths[i]);
+        height = std::max(height, heights[i]);
+    }
+
+    bool written = false;
+    if( loaded ) {
+        // Smaller maps (e.g. a 1x1 constant) are stretched to the largest, nearest texel
+        std::vector<unsigned char> packed((size_t)width * height * 4);
+        for( int y = 0; y < height; y++ ) {
+            for( int x = 0; x < width; x++ ) {
+                unsigned char * texel = &packed[((size_t)y * width + x) * 4];
+                for( int i = 0; i < 3; i++ ) {
+                    int sx = x * widths[i] / width, sy = y * heights[i] / height;
+                    texel[i] = maps[i][((size_t)sy * widths[i] + sx) * 4];   // Red channel
+                }
+                texel[3] = 255;
+            }
+        }
+
+        written = stbi_write_png(packedName.c_str(), width, height, 4, packed.data(), width * 4) != 0;
+        if( written ) std::cout << "Packed " << packedName << " (" << width << "x" << height << ")" << std::endl;
+        else std::cerr << "Unable to write " << packedName << std::endl;
+    }
+
+    for( unsigned char * map : maps ) {
+        if( map != nullptr ) deletePixels(map);
+    }
+    return written;
 }
 
-GLuint Texture::loadCubeMap(const std::string &baseName, const std::string &extension) {
-    GLuint texID;
-    glGenTextures(1, &texID);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, texID);
+/*static*/
+Texture::Data Texture::prepareCubeMap( const std::string & baseName, const std::string & extension, bool parallel ) {
+    Data tex;
+    tex.internalFormat = GL_RGBA8;
+    tex.format = GL_RGBA;
+    tex.type = GL_UNSIGNED_BYTE;
+    prepareFaces(tex, baseName, extension, parallel, [](int, const std::string & name, int & w, int & h, std::vector<unsigned char> & image) {
+        unsigned char * pixels = Texture::loadPixels(name, w, h, false);
+        if( pixels == nullptr ) return false;
+        image.assign(pixels, pixels + (size_t)w * h * 4);
+        Texture::deletePixels(pixels);
+        return true;
+    });
+    return tex;
+}
 
-    const char * suffixes[] = { "posx", "negx", "posy", "negy", "posz", "negz" };
-    GLint w, h;
+/*static*/
+Texture::Data Texture::prepareHdrCubeMap( const std::string & baseName, bool parallel, HdrFormat format ) {
+    Data tex;
+    HdrEncode::Error errors[6];
 
-    // Load the first one to get width/height
-    std::string texName = baseName + "_" + suffixes[0] + extension;
-    GLubyte * data = Texture::loadPixels(texName, w, h, false);
+    // Faces are read by HdrFile, straight to RGB9_E5 when that's the format wanted. Anything
+    // it can't read goes through stb, then gets converted the same way.
+    prepareFaces(tex, baseName, ".hdr", parallel, [&errors, format](int face, const std::string & name, int & w, int & h,
+                                                                     std::vector<unsigned char> & image) {
+        HdrFile::Output output = (format == HdrFormat::RGB9E5) ? HdrFile::Output::RGB9E5 : HdrFile::Output::RGB32F;
+        if( !HdrFile::load(name, output, w, h, image, &errors[face]) ) {
+            errors[face] = HdrEncode::Error();
+            float * pixels = stbi_loadf(name.c_str(), &w, &h, NULL, 3);
+            if( pixels == nullptr ) return false;
+            if( format == HdrFormat::RGB9E5 ) {
+                image = HdrEncode::encodeRgb9e5(pixels, (size_t)w * h, errors[face]);
+            } else {
+                unsigned char * bytes = (unsigned char *)pixels;
+                image.assign(bytes, bytes + (size_t)w * h * 3 * sizeof(float));
+            }
+            stbi_image_free(pixels);
+        }
+        if( format == HdrFormat::RGB16F ) {
+            image = HdrEncode::encodeRgba16f((const float *)image.data(), (size_t)w * h, errors[face]);
+        }
+        return true;
+    });
 
-    // Allocate immutable storage for the whole cube map texture
-    glTexStorage2D(GL_TEXTURE_CUBE_MAP, 1, GL_RGBA8, w, h);
-    glTexSubImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X, 0, 0, 0, w, h, GL_RGBA, GL_UNSIGNED_BYTE, data);
-    stbi_image_free(data);
+    setHdrFormat(tex, format);
+    if( format != HdrFormat::RGB32F && tex.width != 0 ) tex.message += conversionReport(baseName, format, tex, errors);
+    return tex;
+}
+
+/*static*/
+Texture::Data Texture::prepareEquirectCubeMap( const std::string & fName, int faceSize, bool parallel, HdrFormat format ) {
+    Data tex;
+    tex.target = GL_TEXTURE_CUBE_MAP;
+    tex.levels = 1;
+    setHdrFormat(tex, format);
+
+    // Cached faces upload as they are
+    std::string cached = equirectCachePath(fName, faceSize, format);
+    Ktx2::Image image;
+    if( isUpToDate(cached, fName) && Ktx2::read(cached, image) && image.faces == 6 && image.vkFormat == hdrVkFormat(format) &&
+        image.width == faceSize && image.height == faceSize && image.levels.size() == 1 &&
+        image.levels[0].size() == (size_t)faceSize * faceSize * hdrTexelBytes(format) * 6 ) {
+        const std::vector<unsigned char> & level = image.levels[0];
+        size_t faceBytes = level.size() / 6;
+        tex.width = tex.height = faceSize;
+        for( int face = 0; face < 6; face++ ) {
+            tex.images.emplace_back(level.begin() + face * faceBytes, level.begin() + (face + 1) * faceBytes);
+        }
+        tex.message = "Loaded " + cached + " (" + std::to_string(tex.storageBytes() / 1024) + " KB)\n";
+        return tex;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    int width, height;
+    std::vector<unsigned char> decoded;
+    float * stbPixels = nullptr;
+    if( !HdrFile::load(fName, HdrFile::Output::RGB32F, width, height, decoded) ) {
+        stbPixels = stbi_loadf(fName.c_str(), &width, &height, NULL, 3);
+        if( stbPixels == nullptr ) {
+            tex.message = "Unable to load " + fName + "\n";
+            return tex;
+        }
+    }
+    auto decodedAt = std::chrono::steady_clock::now();
 
-    // Load the other 5 cube-map faces
-    for( int i = 1; i < 6; i++ ) {
-        std::string texName = baseName + "_" + suffixes[i] + extension;
-        data = Texture::loadPixels(texName, w, h, false);
-        glTexSubImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, 0, 0, w, h, GL_RGBA, GL_UNSIGNED_BYTE, data);
-        stbi_image_free(data);
+    const float * pixels = stbPixels ? stbPixels : (const float *)decoded.data();
+    std::vector<std::vector<float>> faces = Equirect::toCubeFaces(pixels, width, height, faceSize, parallel);
+    if( stbPixels != nullptr ) stbi_image_free(stbPixels);
+    decoded = std::vector<unsigned char>();
+
+    // Faces are converted to the storage format in parallel too
+    HdrEncode::Error errors[6];
+    tex.width = tex.height = faceSize;
+    tex.images.assign(6, std::vector<unsigned char>());
+    auto encodeFace = [&](int face) {
+        const float * rgb = faces[face].data();
+        size_t texels = (size_t)faceSize * faceSize;
+        switch( format ) {
+            case HdrFormat::RGB32F:
+                tex.images[face].assign((const unsigned char *)rgb, (const unsigned char *)(rgb + texels * 3));
+                break;
+            case HdrFormat::RGB16F:
+                tex.images[face] = HdrEncode::encodeRgba16f(rgb, texels, errors[face]);
+                break;
+            case HdrFormat::RGB9E5:
+                tex.images[face] = HdrEncode::encodeRgb9e5(rgb, texels, errors[face]);
+                break;
+        }
+        faces[face] = std::vector<float>();
+    };
+    std::future<void> jobs[6];
+    for( int face = 0; face < 6; face++ ) {
+        if( parallel ) jobs[face] = ThreadPool::shared().submit([&encodeFace, face]() { encodeFace(face); });
+        else encodeFace(face);
     }
+    for( int face = 0; face < 6 && parallel; face++ ) jobs[face].get();
 
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+    auto ms = [](std::chrono::steady_clock::duration d) { return std::chrono::duration<double, std::milli>(d).count(); };
+    char timing[160];
+    snprintf(timing, sizeof(timing), " (%dx%d) to six %dx%d faces in %.1f ms (decoding %.1f ms) on %d threads\n",
+             width, height, faceSize, faceSize, ms(std::chrono::steady_clock::now() - start), ms(decodedAt - start),
+             parallel ? ThreadPool::shared().size() : 1);
+    tex.message = "Resampled " + fName + timing;
+    if( format != HdrFormat::RGB32F ) tex.message += conversionReport(fName, format, tex, errors);
 
-    return texID;
+    // Cube map levels hold their faces one after another
+    image.vkFormat = hdrVkFormat(format);
+    image.width = image.height = faceSize;
+    image.faces = 6;
+    image.levels.assign(1, std::vector<unsigned char>());
+    for( const std::vector<unsigned char> & face : tex.images ) image.levels[0].insert(image.levels[0].end(), face.begin(), face.end());
+    if( Ktx2::write(cached, image) ) {
+        tex.message += "Cached " + fName + " as " + cached + "\n";
+    } else {
+        tex.message += "Unable to write cached cube map " + cached + "\n";
+    }
+    return tex;
 }
 
-GLuint Texture::loadHdrCubeMap(const std::string &baseName) {
-    GLuint texID;
-    glGenTextures(1, &texID);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, texID);
+void Texture::setParameters( GLuint texture, GLenum target ) {
+    glTextureParameteri(texture, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    if( target == GL_TEXTURE_CUBE_MAP ) {
+        glTextureParameteri(texture, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTextureParameteri(texture, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTextureParameteri(texture, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTextureParameteri(texture, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+    } else {
+        glTextureParameteri(texture, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    }
+}
 
-    const char * suffixes[] = { "posx", "negx", "posy", "negy", "posz", "negz" };
-    GLint w, h;
+/*static*/
+GLuint Texture::upload( const Data & data ) {
+    std::cout << data.message;
+    if( data.internalFormat == 0 || data.width == 0 ) return 0;
 
-    // Load the first one to get width/height
-    std::string texName = baseName + "_" + suffixes[0] + ".hdr";
-    float * data = stbi_loadf(texName.c_str(), &w, &h, NULL, 3);
+    GLuint tex;
+    glGenTextures(1, &tex);
+    glBindTexture(data.target, tex);
+    glTexStorage2D(data.target, data.levels, data.internalFormat, data.width, data.height);
+    for( int face = 0; face < data.faces(); face++ ) {
+        GLenum imageTarget = (data.target == GL_TEXTURE_CUBE_MAP) ? GL_TEXTURE_CUBE_MAP_POSITIVE_X + face : GL_TEXTURE_2D;
+        for( int level = 0; level < data.levels; level++ ) {
+            const std::vector<unsigned char> & image = data.images[face * data.levels + level];
+            if( image.empty() ) continue;   // Missing cube map face
 
-    // Allocate immutable storage for the whole cube map texture
-    glTexStorage2D(GL_TEXTURE_CUBE_MAP, 1, GL_RGB32F, w, h);
-    glTexSubImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X, 0, 0, 0, w, h, GL_RGB, GL_FLOAT, data);
-    stbi_image_free(data);
+            int w = std::max(1, data.width >> level), h = std::max(1, data.height >> level);
+            if( data.compressed() ) {
+                glCompressedTexSubImage2D(imageTarget, level, 0, 0, w, h, data.internalFormat, (GLsizei)image.size(), image.data());
+            } else {
+                glTexSubImage2D(imageTarget, level, 0, 0, w, h, data.format, data.type, image.data());
+            }
+        }
+    }
+
+    setParameters(tex, data.target);
+    return tex;
+}
+
+/*static*/
+GLuint Texture::loadTexture( const std::string & fName, const Options & options ) {
+    return upload(prepareTexture(fName, options));
+}
 
-    // Load the other 5 cube-map faces
-    for( int i = 1; i < 6; i++ ) {
-        std::string texName = baseName + "_" + suffixes[i] + ".hdr";
-        data = stbi_loadf(texName.c_str(), &w, &h, NULL, 3);
-        glTexSubImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, 0, 0, w, h, GL_RGB, GL_FLOAT, data);
-        stbi_image_free(data);
+std::vector<GLuint> Texture::loadTextures( const std::vector<Request> & requests ) {
+    auto start = std::chrono::steady_clock::now();
+    ThreadPool & pool = ThreadPool::shared();
+
+    // Identical requests share one texture. Preparing them separately would also have two
+    // workers writing the same cooked file.
+    std::vector<size_t> first(requests.size());
+    std::vector<std::future<Data>> jobs(requests.size());
+    for( size_t i = 0; i < requests.size(); i++ ) {
+        first[i] = i;
+        for( size_t j = 0; j < i; j++ ) {
+            if( requests[j].fName == requests[i].fName && requests[j].options == requests[i].options ) {
+                first[i] = j;
+                break;
+            }
+        }
+        if( first[i] == i ) {
+            Request request = requests[i];
+            jobs[i] = pool.submit([request]() { return prepareTexture(request.fName, request.options); });
+        }
+    }
+
+    // Upload in request order, while later images are still being decoded
+    std::vector<GLuint> textures(requests.size(), 0);
+    for( size_t i = 0; i < requests.size(); i++ ) {
+        textures[i] = (first[i] == i) ? upload(jobs[i].get()) : textures[first[i]];
+    }
+
+    auto ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "Loaded " << requests.size() << " textures in " << ms << " ms on "
+              << pool.size() << " threads" << std::endl;
+    return textures;
+}
+
+void Texture::setSamplerFiltering( GLuint sampler, Filtering filtering ) {
+    GLfloat maxAnisotropy = 1.0f;
+    if( filtering == Filtering::Anisotropic ) {
+        glGetFloatv(GL_MAX_TEXTURE_MAX_ANISOTROPY, &maxAnisotropy);
+    }
+
+    glSamplerParameteri(sampler, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glSamplerParameteri(sampler, GL_TEXTURE_MIN_FILTER,
+                        filtering == Filtering::Nearest ? GL_NEAREST : GL_LINEAR_MIPMAP_LINEAR);
+    glSamplerParameterf(sampler, GL_TEXTURE_MAX_ANISOTROPY, maxAnisotropy);
+}
+
+const char * Texture::filteringName( Filtering filtering ) {
+    switch( filtering ) {
+        case Filtering::Nearest: return "nearest";
+        case Filtering::Trilinear: return "trilinear";
+        case Filtering::Anisotropic: return "anisotropic";
+    }
+    return "";
+}
+
+const char * Texture::hdrFormatName( HdrFormat format ) {
+    switch( format ) {
+        case HdrFormat::RGB32F: return "RGB32F";
+        case HdrFormat::RGB16F: return "RGB16F";
+        case HdrFormat::RGB9E5: return "RGB9_E5";
     }
+    return "";
+}
 
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+void Texture::deletePixels(unsigned char *data) {
+    stbi_image_free(data);
+}
+
+unsigned char *Texture::loadPixels(const std::string &fName, int & width, int & height, bool flip) {
+    // This version of stb only has a global flip setting, so rows are swapped here instead,
+    // which keeps loadPixels safe to call from several threads at once
+    int bytesPerPix;
+    unsigned char *data = stbi_load(fName.c_str(), &width, &height, &bytesPerPix, 4);
+    if( data != nullptr && flip ) {
+        size_t rowBytes = (size_t)width * 4;
+        for( int y = 0; y < height / 2; y++ ) {
+            std::swap_ranges(data + y * rowBytes, data + (y + 1) * rowBytes, data + (height - 1 - y) * rowBytes);
+        }
+    }
+    return data;
+}
 
-    return texID;
+GLuint Texture::loadCubeMap(const std::string &baseName, const std::string &extension) {
+    return upload(prepareCubeMap(baseName, extension, true));
 }
 
+GLuint Texture::loadHdrCubeMap(const std::string &baseName, HdrFormat format) {
+    return upload(prepareHdrCubeMap(baseName, true, format));
+}
 
+GLuint Texture::loadEquirectCubeMap(const std::string &fName, int faceSize, HdrFormat format) {
+    return upload(prepareEquirectCubeMap(fName, faceSize, true, format));
+}
@@ -1,12 +1,133 @@
+#pragma once
 
 #include <glad/glad.h>
 #include <string>
+#include <vector>
+#include "mipmap.h"
+#include "blockcompression.h"
 
 class Texture {
 public:
-    static GLuint loadTexture( const std::string & fName );
+    // Minification filtering, set on a texture or sampler object
+    enum class Filtering {
+        Nearest,        // No mips used
+        Trilinear,
+        Anisotropic     // Trilinear plus the maximum anisotropy the driver supports
+    };
+
+    // GPU storage format
+    enum class Compression {
+        None,   // RGBA8, or SRGB8_ALPHA8 for sRGB data
+        BC4,    // Single channel maps (metallic, roughness, AO), read from red
+        BC5,    // Tangent space normal maps. Only X and Y are stored, so shaders rebuild Z.
+        BC7     // Colour maps, as BPTC_SRGB for sRGB data
+    };
+
+    // GPU storage of HDR cube maps, converted from the float source at load
+    enum class HdrFormat {
+        RGB32F,     // As decoded, 12 bytes per texel
+        RGB16F,     // Half floats, 8 bytes per texel as drivers pad it to RGBA
+        RGB9E5      // Shared exponent, 4 bytes per texel. Plenty for a sky, which is only ever tone mapped.
+    };
+
+    struct Options {
+        bool srgb;                  // Colour data (albedo) stored sRGB encoded, in an sRGB format so
+                                    // the texture unit decodes it, before filtering, and shaders read linear values
+        Compression compression;
+        MipMap::Filter mipFilter;
+
+        Options(bool srgb = false, Compression compression = Compression::None,
+                MipMap::Filter mipFilter = MipMap::Filter::Box) :
+            srgb(srgb), compression(compression), mipFilter(mipFilter) { }
+
+        bool operator==( const Options & o ) const {
+            return srgb == o.srgb && compression == o.compression && mipFilter == o.mipFilter;
+        }
+    };
+
+    struct Request {
+        std::string fName;
+        Options options;
+    };
+
+    // A texture's images in CPU memory, ready to upload
+    struct Data {
+        GLenum target = GL_TEXTURE_2D;      // Or GL_TEXTURE_CUBE_MAP
+        GLenum internalFormat = 0;          // 0 if loading failed
+        GLenum format = 0, type = 0;        // Pixel transfer format and type, 0 for block compressed data
+        int width = 0, height = 0;
+        int levels = 0;
+        int baseLevel = 0;                  // Finest level in images. Those above it were left on disk.
+        std::vector<std::vector<unsigned char>> images;   // images[face * levels + level], empty for a missing face
+        std::string message;                // Printed at upload, so output from workers stays in order
+
+        int faces() const { return target == GL_TEXTURE_CUBE_MAP ? 6 : 1; }
+        bool compressed() const { return format == 0; }
+
+        // GPU memory used by the texture's storage
+        size_t storageBytes() const {
+            size_t bytes = 0;
+            for( int level = 0; level < levels && level < (int)images.size(); level++ ) bytes += images[level].size();
+            return bytes * faces();
+        }
+    };
+
+    // The CPU half of the loaders below: decoding, mip generation and cooking. These make no
+    // GL calls, so can run on worker threads. With parallel set the cube map faces are decoded
+    // on ThreadPool::shared(), which must not be done from one of its own jobs.
+    // With maxSize set, compressed textures only read the levels no larger than maxSize
+    // from the cooked file, leaving the finer ones empty (see MipStreamer).
+    static Data prepareTexture( const std::string & fName, const Options & options = Options(), int maxSize = 0 );
+    // Levels firstLevel to endLevel - 1 of an already cooked texture, for streaming in finer
+    // levels. Loading fails (internalFormat 0) if it isn't cooked, or is out of date.
+    static Data prepareLevels( const std::string & fName, const Options & options, int firstLevel, int endLevel );
+    static Data prepareCubeMap( const std::string & baseName, const std::string & extension = ".png", bool parallel = false );
+    static Data prepareHdrCubeMap( const std::string & baseName, bool parallel = false, HdrFormat format = HdrFormat::RGB32F );
+    static Data prepareEquirectCubeMap( const std::string & fName, int faceSize, bool parallel = false,
+                                        HdrFormat format = HdrFormat::RGB32F );
+
+    // Asset step for materials: packs the red channels of three greyscale maps into one
+    // RGB image, R = ambient occlusion, G = roughness and B = metallic, so shaders read all
+    // three with a single fetch. The image is written to packedName as a PNG, then loads
+    // (and cooks) like any other texture, without sRGB. It is only packed again when one of
+    // the maps is newer. Returns false, with the reason printed, if it couldn't be packed.
+    static bool packOrm( const std::string & ao, const std::string & roughness, const std::string & metallic,
+                         const std::string & packedName );
+
+    // Create a texture from prepared data, copying straight from client memory
+    static GLuint upload( const Data & data );
+
+    // Filtering and wrapping used for textures of target
+    static void setParameters( GLuint texture, GLenum target );
+
+    // Loads with a full mip chain generated on the CPU (see MipMap::generate).
+    //
+    // Compressed textures are cooked once into a KTX2 file beside the source image, named
+    // after it and the format (e.g. albedo.bc7.ktx2), and later loads upload that file's
+    // blocks directly. The file is cooked again whenever the source image is newer.
+    static GLuint loadTexture( const std::string & fName, const Options & options = Options() );
+
+    // Loads a batch of textures, decoding (or cooking) the images concurrently on
+    // ThreadPool::shared(). The GL uploads happen on the calling thread, in request order,
+    // overlapping the decoding of later images. Returns one texture per request, or 0
+    // where loading failed. Identical requests get the same texture.
+    static std::vector<GLuint> loadTextures( const std::vector<Request> & requests );
+
+    // Faces are decoded in parallel
     static GLuint loadCubeMap(const std::string & baseName, const std::string & extention = ".png");
-    static GLuint loadHdrCubeMap( const std::string & baseName );
+    static GLuint loadHdrCubeMap( const std::string & baseName, HdrFormat format = HdrFormat::RGB32F );
+
+    // A cube map with faceSize x faceSize faces, resampled from one equirectangular .hdr image
+    // (see Equirect::toCubeFaces). A quarter of the image's width keeps its detail at the horizon.
+    // The faces are cached in format to a KTX2 file beside the image, named after it, the face
+    // size and the format (e.g. sky.cube1024.rgb9_e5.ktx2), which later loads upload directly.
+    // The cache is rebuilt whenever the image is newer.
+    static GLuint loadEquirectCubeMap( const std::string & fName, int faceSize, HdrFormat format = HdrFormat::RGB32F );
+    // Safe to call from any thread
     static unsigned char * loadPixels( const std::string & fName, int & w, int & h, bool flip = true );
     static void deletePixels( unsigned char * );
-};
\ No newline at end of file
+
+    static void setSamplerFiltering( GLuint sampler, Filtering filtering );
+    static const char * filteringName( Filtering filtering );
+    static const char * hdrFormatName( HdrFormat format );
+};
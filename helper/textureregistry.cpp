@@ -0,0 +1,156 @@
+#include "textureregistry.h"
+
+#include <filesystem>
+
+SharedTexture::~SharedTexture() {
+    if( texture == 0 ) return;   // Lazy, and never used
+    if( uploader != nullptr ) uploader->cancel(texture);
+    if( streamer != nullptr ) streamer->release(texture);
+    glDeleteTextures(1, &texture);
+}
+
+GLuint SharedTexture::use() const {
+    if( start ) {
+        std::function<GLuint()> queue = std::move(start);
+        start = nullptr;
+        texture = queue();
+    }
+    return (placeholder != 0 && residentBytes == 0) ? placeholder : texture;
+}
+
+TextureRegistry::TextureRegistry(TextureUploader * uploader, MipStreamer * streamer) :
+    uploader(uploader), streamer(streamer), placeholders() { }
+
+TextureRegistry::~TextureRegistry() {
+    for( GLuint texture : placeholders ) {
+        if( texture != 0 ) glDeleteTextures(1, &texture);
+    }
+}
+
+// Canonical path, then the options that change what gets uploaded
+std::string TextureRegistry::makeKey(const std::string & fName, const Texture::Options & options) {
+    std::error_code ec;
+    std::filesystem::path path = std::filesystem::weakly_canonical(fName, ec);
+    if( ec ) path = std::filesystem::path(fName).lexically_normal();
+
+    std::string key = path.generic_string();
+    key.push_back('\0');
+    key.push_back((char)options.srgb);
+    key.push_back((char)options.compression);
+    key.push_back((char)options.mipFilter);
+    return key;
+}
+
+TextureRegistry::Handle TextureRegistry::get(const std::string & key, GLenum target, Load when,
+                                              std::function<Texture::Data()> prepare,
+                                              std::function<GLuint(TextureUploader::Allocated)> stream) {
+    auto it = entries.find(key);
+    if( it != entries.end() ) {
+        if( Handle existing = it->second.lock() ) {
+            if( when == Load::Now ) existing->use();
+            return existing;
+        }
+    }
+
+    purge();
+    std::shared_ptr<SharedTexture> shared(new SharedTexture(0, uploader, streamer));
+    entries[key] = shared;
+
+    if( !stream ) {
+        Texture::Data data = prepare();
+        shared->texture = Texture::upload(data);
+        if( shared->texture != 0 ) shared->residentBytes = data.storageBytes();
+    } else {
+        // The texture name exists before its data, so the size is filled in once it's allocated
+        std::weak_ptr<SharedTexture> weak = shared;
+        shared->start = [weak, stream]() {
+            return stream([weak](size_t bytes) {
+                if( std::shared_ptr<SharedTexture> t = weak.lock() ) t->residentBytes = bytes;
+            });
+        };
+        if( when == Load::OnFirstUse ) shared->placeholder = placeholder(target);
+        else shared->use();
+    }
+    return shared;
+}
+
+TextureRegistry::Handle TextureRegistry::load(const std::string & fName, const Texture::Options & options, Load when) {
+    std::function<GLuint(TextureUploader::Allocated)> stream;
+    if( streamer != nullptr && options.compression != Texture::Compression::None ) {
+        MipStreamer * s = streamer;
+        stream = [s, fName, options](TextureUploader::Allocated resident) { return s->load(fName, options, resident); };
+    } else if( uploader != nullptr ) {
+        TextureUploader * u = uploader;
+        stream = [u, fName, options](TextureUploader::Allocated allocated) { return u->load(fName, options, allocated); };
+    }
+    return get(makeKey(fName, options), GL_TEXTURE_2D, when, [&]() { return Texture::prepareTexture(fName, options); }, stream);
+}
+
+TextureRegistry::Handle TextureRegistry::loadHdrCubeMap(const std::string & baseName, Texture::HdrFormat format, Load when) {
+    // Keyed on the first face and the storage format
+    std::string key = makeKey(baseName + "_posx.hdr", Texture::Options());
+    key.push_back((char)format);
+    std::function<GLuint(TextureUploader::Allocated)> stream;
+    if( uploader != nullptr ) {
+        TextureUploader * u = uploader;
+        stream = [u, baseName, format](TextureUploader::Allocated allocated) { return u->loadHdrCubeMap(baseName, format, allocated); };
+    }
+    return get(key, GL_TEXTURE_CUBE_MAP, when, [&]() { return Texture::prepareHdrCubeMap(baseName, true, format); }, stream);
+}
+
+TextureRegistry::Handle TextureRegistry::loadEquirectCubeMap(const std::string & fName, int faceSize, Texture::HdrFormat format,
+                                                              Load when) {
+    // Keyed on the image, the face size and the storage format
+    std::string key = makeKey(fName, Texture::Options());
+    key.push_back('\0');
+    key += "cube" + std::to_string(faceSize);
+    key.push_back((char)format);
+    std::function<GLuint(TextureUploader::Allocated)> stream;
+    if( uploader != nullptr ) {
+        TextureUploader * u = uploader;
+        stream = [u, fName, faceSize, format](TextureUploader::Allocated allocated) {
+            return u->loadEquirectCubeMap(fName, faceSize, format, allocated);
+        };
+    }
+    return get(key, GL_TEXTURE_CUBE_MAP, when, [&]() { return Texture::prepareEquirectCubeMap(fName, faceSize, true, format); }, stream);
+}
+
+// A 1x1 mid grey texture: a dull colour, a flat normal and middling ORM values
+GLuint TextureRegistry::placeholder(GLenum target) {
+    GLuint & texture = placeholders[target == GL_TEXTURE_CUBE_MAP ? 1 : 0];
+    if( texture != 0 ) return texture;
+
+    const unsigned char grey[4] = { 128, 128, 128, 255 };
+    glCreateTextures(target, 1, &texture);
+    glTextureStorage2D(texture, 1, GL_RGBA8, 1, 1);
+    if( target == GL_TEXTURE_CUBE_MAP ) {
+        for( int face = 0; face < 6; face++ ) {
+            glTextureSubImage3D(texture, 0, 0, 0, face, 1, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, grey);
+        }
+    } else {
+        glTextureSubImage2D(texture, 0, 0, 0, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, grey);
+    }
+    Texture::setParameters(texture, target);
+    return texture;
+}
+
+size_t TextureRegistry::size() {
+    purge();
+    return entries.size();
+}
+
+size_t TextureRegistry::residentBytes() {
+    purge();
+    size_t bytes = 0;
+    for( const auto & entry : entries ) {
+        if( Handle texture = entry.second.lock() ) bytes += texture->bytes();
+    }
+    return bytes;
+}
+
+void TextureRegistry::purge() {
+    for( auto it = entries.begin(); it != entries.end(); ) {
+        if( it->second.expired() ) it = entries.erase(it);
+        else ++it;
+    }
+}
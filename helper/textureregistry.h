@@ -0,0 +1,107 @@
+#pragma once
+
+#include <glad/glad.h>
+#include "texture.h"
+#include "textureuploader.h"
+#include "mipstreamer.h"
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+
+// A GL texture shared through a TextureRegistry. The texture is deleted along with the
+// last handle to it.
+class SharedTexture
+{
+public:
+    ~SharedTexture();
+
+    SharedTexture(const SharedTexture &) = delete;
+    SharedTexture & operator=(const SharedTexture &) = delete;
+
+    // The texture itself, 0 until a lazy texture is first used
+    GLuint id() const { return texture; }
+
+    // The texture to bind for drawing. A lazy texture starts loading on its first use, and
+    // gives the registry's 1x1 placeholder until its storage is allocated.
+    GLuint use() const;
+
+    // GPU memory used, 0 until a streamed texture's storage is allocated
+    size_t bytes() const { return residentBytes; }
+
+private:
+    friend class TextureRegistry;
+
+    SharedTexture(GLuint texture, TextureUploader * uploader, MipStreamer * streamer) :
+        texture(texture), uploader(uploader), streamer(streamer), residentBytes(0), placeholder(0) { }
+
+    mutable GLuint texture;
+    TextureUploader * uploader;     // Still streaming into texture, perhaps
+    MipStreamer * streamer;
+    size_t residentBytes;
+    GLuint placeholder;             // Lazy textures only
+    mutable std::function<GLuint()> start;   // Queues a lazy texture's load, empty once started
+};
+
+// Shares textures between everything that loads the same image with the same options,
+// so each one is decoded and uploaded once. Paths are compared in canonical form, so
+// "media/./textures/a.png" and "media/textures/a.png" are the same texture. Like
+// GeometryCache, entries only hold weak references, so the registry never keeps a
+// texture alive by itself. Only use it on the GL thread.
+//
+// Textures loaded with Load::OnFirstUse (lazily) aren't read or decoded until the first
+// SharedTexture::use(), normally when something drawing with them is first on screen, and
+// a 1x1 mid grey placeholder is bound in their place until their storage is allocated.
+//
+//     TextureRegistry::Handle albedo = registry.load("media/textures/albedo.png", Texture::Options(true));
+//     glBindTextureUnit(3, albedo->use());
+class TextureRegistry
+{
+public:
+    using Handle = std::shared_ptr<const SharedTexture>;
+
+    enum class Load {
+        Now,
+        OnFirstUse      // Needs an uploader, and loads now without one
+    };
+
+    // With an uploader, textures are streamed in through it. Otherwise they are loaded
+    // before load() returns. With a streamer, compressed textures instead load just their
+    // smallest levels, and finer ones follow what is on screen. Both, and the registry itself
+    // (which owns the placeholders), must outlive every handle.
+    explicit TextureRegistry(TextureUploader * uploader = nullptr, MipStreamer * streamer = nullptr);
+    ~TextureRegistry();
+
+    TextureRegistry(const TextureRegistry &) = delete;
+    TextureRegistry & operator=(const TextureRegistry &) = delete;
+
+    // Loading an already lazy texture with Load::Now starts it
+    Handle load(const std::string & fName, const Texture::Options & options = Texture::Options(), Load when = Load::Now);
+    Handle loadHdrCubeMap(const std::string & baseName, Texture::HdrFormat format = Texture::HdrFormat::RGB32F,
+                          Load when = Load::Now);
+    Handle loadEquirectCubeMap(const std::string & fName, int faceSize, Texture::HdrFormat format = Texture::HdrFormat::RGB32F,
+                               Load when = Load::Now);
+
+    // Number of textures currently alive
+    size_t size();
+
+    // GPU memory used by the textures currently alive
+    size_t residentBytes();
+
+private:
+    TextureUploader * uploader;
+    MipStreamer * streamer;
+    std::map<std::string, std::weak_ptr<SharedTexture>> entries;
+    GLuint placeholders[2];             // 2D and cube map, made when first needed
+
+    static std::string makeKey(const std::string & fName, const Texture::Options & options);
+
+    // The live texture for key, or a new one from stream (through the uploader or streamer), if
+    // given, or else from prepare (loading now). A lazy one is of target, and only streamed once used.
+    // The functions are kept until then, so must hold copies of what they use.
+    Handle get(const std::string & key, GLenum target, Load when, std::function<Texture::Data()> prepare,
+               std::function<GLuint(TextureUploader::Allocated)> stream);
+    GLuint placeholder(GLenum target);
+    void purge();
+};
@@ -0,0 +1,289 @@
+#include "textureuploader.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+namespace {
+    // Images start on block boundaries in the ring
+    const size_t IMAGE_ALIGNMENT = 16;
+
+    size_t alignUp(size_t v, size_t alignment) {
+        return (v + alignment - 1) / alignment * alignment;
+    }
+}
+
+TextureUploader::TextureUploader(size_t ringBytes, size_t frameBudget) :
+    buffer(0), mapped(nullptr), ringBytes(ringBytes), frameBudget(frameBudget),
+    head(0), stopping(false), nextSerial(0), needsFence(false), frame(1), completedFrame(0), pending(0),
+    streamedBytes(0), streamedTextures(0), streamingFrames(0)
+{
+    GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    glCreateBuffers(1, &buffer);
+    glNamedBufferStorage(buffer, ringBytes, nullptr, flags);
+    mapped = (unsigned char *)glMapNamedBufferRange(buffer, 0, ringBytes, flags);
+}
+
+TextureUploader::~TextureUploader() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    spaceFreed.notify_all();
+    for( std::future<void> & job : jobs ) job.wait();
+
+    for( FrameFence & fence : fences ) glDeleteSync(fence.sync);
+    glUnmapNamedBuffer(buffer);
+    glDeleteBuffers(1, &buffer);
+}
+
+GLuint TextureUploader::load(const std::string & fName, const Texture::Options & options, Allocated allocated) {
+    return queue(GL_TEXTURE_2D, allocated, [fName, options]() {
+        return Texture::prepareTexture(fName, options);
+    });
+}
+
+GLuint TextureUploader::loadHdrCubeMap(const std::string & baseName, Texture::HdrFormat format, Allocated allocated) {
+    return queue(GL_TEXTURE_CUBE_MAP, allocated, [baseName, format]() {
+        return Texture::prepareHdrCubeMap(baseName, false, format);
+    });
+}
+
+GLuint TextureUploader::loadEquirectCubeMap(const std::string & fName, int faceSize, Texture::HdrFormat format,
+                                            Allocated allocated) {
+    // Resampling is spread over ThreadPool::shared(), which is safe from the uploader's own workers
+    return queue(GL_TEXTURE_CUBE_MAP, allocated, [fName, faceSize, format]() {
+        return Texture::prepareEquirectCubeMap(fName, faceSize, true, format);
+    });
+}
+
+GLuint TextureUploader::queue(GLenum target, Allocated allocated, std::function<Texture::Data()> prepare) {
+    GLuint texture;
+    glCreateTextures(target, 1, &texture);
+    unsigned long long serial = nextSerial++;
+    inFlight[texture] = serial;
+    pending++;
+
+    jobs.push_back(workers.submit([this, texture, serial, allocated, prepare]() {
+        stage(texture, serial, allocated, prepare());
+    }));
+    return texture;
+}
+
+void TextureUploader::cancel(GLuint texture) {
+    auto it = inFlight.find(texture);
+    if( it == inFlight.end() ) return;
+    cancelled.insert(it->second);
+    inFlight.erase(it);
+}
+
+// Worker side: copy the prepared images into the ring and hand them to the GL thread
+void TextureUploader::stage(GLuint texture, unsigned long long serial, Allocated allocated, Texture::Data data) {
+    Upload upload;
+    upload.texture = texture;
+    upload.serial = serial;
+    upload.allocated = allocated;
+    upload.region = 0;
+    upload.started = false;
+    upload.inRing = false;
+    upload.direct = false;
+    upload.next = (int)data.images.size();
+
+    size_t total = 0;
+    for( const std::vector<unsigned char> & image : data.images ) {
+        upload.offsets.push_back(total);
+        total = alignUp(total + image.size(), IMAGE_ALIGNMENT);
+    }
+
+    if( data.internalFormat != 0 && data.width > 0 ) {
+        if( total > ringBytes ) {
+            upload.direct = true;
+        } else {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                spaceFreed.wait(lock, [&]() { return stopping || allocate(total, upload.region); });
+                if( stopping ) return;
+            }
+            upload.inRing = true;
+
+            for( size_t i = 0; i < data.images.size(); i++ ) {
+                upload.offsets[i] += upload.region;
+                memcpy(mapped + upload.offsets[i], data.images[i].data(), data.images[i].size());
+            }
+        }
+    }
+
+    upload.data = std::move(data);
+    std::lock_guard<std::mutex> lock(mutex);
+    ready.push_back(std::move(upload));
+}
+
+// Called with the mutex held
+bool TextureUploader::allocate(size_t size, size_t & offset) {
+    if( regions.empty() ) head = 0;
+    size_t tail = regions.empty() ? 0 : regions.front().offset;
+    if( !regions.empty() && head == tail ) return false;   // Full
+
+    size_t at;
+    if( regions.empty() || head > tail ) {
+        // Free space runs from head to the end, then from the start to tail
+        if( ringBytes - head >= size ) at = head;
+        else if( tail >= size ) at = 0;
+        else return false;
+    } else {
+        if( tail - head >= size ) at = head;
+        else return false;
+    }
+
+    regions.push_back({ at, size, false, 0 });
+    head = at + size;
+    if( head == ringBytes ) head = 0;
+    offset = at;
+    return true;
+}
+
+// Free the ring space of uploads the GPU has finished reading
+void TextureUploader::retire() {
+    while( !fences.empty() ) {
+        GLenum status = glClientWaitSync(fences.front().sync, 0, 0);
+        if( status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED ) break;
+        completedFrame = fences.front().frame;
+        glDeleteSync(fences.front().sync);
+        fences.pop_front();
+    }
+
+    bool freed = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        while( !regions.empty() && regions.front().done && regions.front().frame <= completedFrame ) {
+            regions.pop_front();
+            freed = true;
+        }
+    }
+    if( freed ) spaceFreed.notify_all();
+}
+
+void TextureUploader::start(const Upload & upload) {
+    const Texture::Data & data = upload.data;
+    std::cout << data.message;
+    if( data.internalFormat == 0 || data.width == 0 ) return;
+
+    glTextureStorage2D(upload.texture, data.levels, data.internalFormat, data.width, data.height);
+    Texture::setParameters(upload.texture, data.target);
+    if( data.target == GL_TEXTURE_2D ) glTextureParameteri(upload.texture, GL_TEXTURE_BASE_LEVEL, data.levels - 1);
+    if( upload.allocated ) upload.allocated(data.storageBytes());
+}
+
+// Hand back the upload's ring space, once the GPU is past this frame
+void TextureUploader::release(const Upload & upload) {
+    if( upload.inRing ) {
+        std::lock_guard<std::mutex> lock(mutex);
+        for( Region & region : regions ) {
+            if( region.offset == upload.region && !region.done ) {
+                region.done = true;
+                region.frame = frame;
+                needsFence = true;
+                break;
+            }
+        }
+    }
+
+    auto it = inFlight.find(upload.texture);
+    if( it != inFlight.end() && it->second == upload.serial ) inFlight.erase(it);
+    pending--;
+}
+
+void TextureUploader::finish(const Upload & upload) {
+    release(upload);
+
+    if( upload.data.internalFormat != 0 && upload.data.width != 0 ) streamedTextures++;
+    if( pending == 0 ) {
+        std::cout << "Streamed " << streamedTextures << " textures (" << streamedBytes / 1024 << " KB) over "
+                  << streamingFrames << " frames" << std::endl;
+    }
+}
+
+void TextureUploader::update() {
+    retire();
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        while( !ready.empty() ) {
+            active.push_back(std::move(ready.front()));
+            ready.pop_front();
+        }
+    }
+
+    // Finished workers
+    jobs.erase(std::remove_if(jobs.begin(), jobs.end(), [](std::future<void> & job) {
+        return job.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+    }), jobs.end());
+
+    size_t budget = frameBudget;
+    bool fromRing = false;
+    while( !active.empty() && budget > 0 ) {
+        Upload & upload = active.front();
+        Texture::Data & data = upload.data;
+        if( cancelled.erase(upload.serial) ) {
+            release(upload);
+            active.pop_front();
+            continue;
+        }
+        if( !upload.started ) {
+            start(upload);
+            upload.started = true;
+        }
+
+        bool failed = (data.internalFormat == 0 || data.width == 0);
+        while( !failed && upload.next > 0 ) {
+            int i = upload.next - 1;
+            size_t bytes = data.images[i].size();
+
+            // Always allow one image a frame, so one larger than the budget still goes
+            if( bytes > budget && budget < frameBudget ) break;
+
+            if( bytes > 0 ) {
+                int face = i / data.levels, level = i % data.levels;
+                int w = std::max(1, data.width >> level), h = std::max(1, data.height >> level);
+                glBindBuffer(GL_PIXEL_UNPACK_BUFFER, upload.direct ? 0 : buffer);
+                const void * pixels = upload.direct ? (const void *)data.images[i].data() : (const void *)upload.offsets[i];
+
+                if( data.target == GL_TEXTURE_CUBE_MAP ) {
+                    if( data.compressed() ) {
+                        glCompressedTextureSubImage3D(upload.texture, level, 0, 0, face, w, h, 1, data.internalFormat, (GLsizei)bytes, pixels);
+                    } else {
+                        glTextureSubImage3D(upload.texture, level, 0, 0, face, w, h, 1, data.format, data.type, pixels);
+                    }
+                } else {
+                    if( data.compressed() ) {
+                        glCompressedTextureSubImage2D(upload.texture, level, 0, 0, w, h, data.internalFormat, (GLsizei)bytes, pixels);
+                    } else {
+                        glTextureSubImage2D(upload.texture, level, 0, 0, w, h, data.format, data.type, pixels);
+                    }
+                    glTextureParameteri(upload.texture, GL_TEXTURE_BASE_LEVEL, level);
+                }
+
+                fromRing |= !upload.direct;
+                streamedBytes += bytes;
+            }
+            budget -= std::min(budget, bytes);
+            upload.next--;
+        }
+
+        if( !failed && upload.next > 0 ) break;   // Out of budget, carry on next frame
+        finish(upload);
+        active.pop_front();
+    }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    if( budget < frameBudget ) streamingFrames++;
+    if( fromRing || needsFence ) {
+        needsFence = false;
+        fences.push_back({ glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0), frame });
+        frame++;
+    }
+}
+
+bool TextureUploader::isIdle() const {
+    return pending == 0;
+}
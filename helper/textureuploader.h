@@ -0,0 +1,120 @@
+#pragma once
+
+#include <glad/glad.h>
+#include "texture.h"
+#include "threadpool.h"
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+// Streams textures to the GPU over several frames. Images are decoded on worker
+// threads, which copy the texels into a ring of persistently mapped pixel unpack
+// buffer memory. Each frame, update() on the GL thread issues
+// glTextureSubImage2D calls that read from offsets in that buffer, so the driver
+// copies them without stalling, until the frame's byte budget is spent. Ring space is
+// reused once a fence placed after its uploads has signalled.
+//
+// Levels are uploaded smallest first, with GL_TEXTURE_BASE_LEVEL following, so a
+// texture sharpens as it streams in. Until its first level arrives it has no storage
+// and samples as black.
+//
+// The workers are the uploader's own rather than ThreadPool::shared(), so workers
+// waiting for ring space never hold up other jobs.
+class TextureUploader
+{
+public:
+    TextureUploader(size_t ringBytes = 32 << 20, size_t frameBudget = 4 << 20);
+    ~TextureUploader();
+
+    TextureUploader(const TextureUploader &) = delete;
+    TextureUploader & operator=(const TextureUploader &) = delete;
+
+    // Called on the GL thread when a texture's storage is allocated, with its size in bytes
+    using Allocated = std::function<void(size_t)>;
+
+    // Queue a load. The texture name is returned straight away, for binding as usual.
+    GLuint load(const std::string & fName, const Texture::Options & options = Texture::Options(),
+                Allocated allocated = nullptr);
+    GLuint loadHdrCubeMap(const std::string & baseName, Texture::HdrFormat format = Texture::HdrFormat::RGB32F,
+                          Allocated allocated = nullptr);
+    GLuint loadEquirectCubeMap(const std::string & fName, int faceSize,
+                               Texture::HdrFormat format = Texture::HdrFormat::RGB32F, Allocated allocated = nullptr);
+
+    // Drop any uploads still due for texture. Call before deleting a texture this
+    // uploader may still be writing, as its name could otherwise be reused and written.
+    void cancel(GLuint texture);
+
+    // Call once per frame on the GL thread
+    void update();
+
+    // True once every queued texture is complete
+    bool isIdle() const;
+
+private:
+    // A prepared texture and where its images sit in the ring
+    struct Upload {
+        GLuint texture;
+        unsigned long long serial;      // Identifies the load, as texture names get reused
+        Allocated allocated;
+        Texture::Data data;
+        size_t region;                  // Start of its ring space
+        std::vector<size_t> offsets;    // Per image in data.images. Unused when direct.
+        bool started;                   // Storage allocated
+        bool inRing;                    // Holds ring space until its uploads are fenced
+        bool direct;                    // Too large for the ring, so uploaded from data.images
+        int next;                       // Images are issued from the back (smallest level) forwards
+    };
+
+    // Ring space in allocation order
+    struct Region {
+        size_t offset, size;
+        bool done;                      // Every upload reading it has been issued
+        unsigned long long frame;       // Frame those uploads were issued in
+    };
+
+    struct FrameFence {
+        GLsync sync;
+        unsigned long long frame;
+    };
+
+    ThreadPool workers;
+    GLuint buffer;
+    unsigned char * mapped;
+    size_t ringBytes, frameBudget;
+
+    // Shared with the workers
+    mutable std::mutex mutex;
+    std::condition_variable spaceFreed;
+    std::deque<Region> regions;
+    size_t head;
+    std::deque<Upload> ready;
+    bool stopping;
+
+    // GL thread only
+    std::vector<std::future<void>> jobs;
+    std::map<GLuint, unsigned long long> inFlight;   // Texture to serial of its queued load
+    std::set<unsigned long long> cancelled;
+    unsigned long long nextSerial;
+    bool needsFence;                    // A region was finished without reading from the ring this frame
+    std::deque<FrameFence> fences;
+    std::deque<Upload> active;
+    unsigned long long frame, completedFrame;
+    int pending;                        // Queued loads not yet complete
+    size_t streamedBytes;
+    int streamedTextures, streamingFrames;
+
+    GLuint queue(GLenum target, Allocated allocated, std::function<Texture::Data()> prepare);
+    void stage(GLuint texture, unsigned long long serial, Allocated allocated, Texture::Data data);
+    void release(const Upload & upload);
+    bool allocate(size_t size, size_t & offset);
+    void retire();
+    void start(const Upload & upload);
+    void finish(const Upload & upload);
+};
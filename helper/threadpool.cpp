@@ -0,0 +1,36 @@
+#include "threadpool.h"
+
+#include <algorithm>
+
+ThreadPool::ThreadPool(int nThreads) : stopping(false) {
+    if( nThreads <= 0 ) nThreads = std::max(1, (int)std::thread::hardware_concurrency());
+    for( int i = 0; i < nThreads; i++ ) workers.emplace_back(&ThreadPool::run, this);
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for( std::thread & t : workers ) t.join();
+}
+
+ThreadPool & ThreadPool::shared() {
+    static ThreadPool pool;
+    return pool;
+}
+
+void ThreadPool::run() {
+    for( ;; ) {
+        std::function<void()> job;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [this]() { return stopping || !jobs.empty(); });
+            if( jobs.empty() ) return;   // Only when stopping, after the queue has drained
+            job = std::move(jobs.front());
+            jobs.pop_front();
+        }
+        job();
+    }
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// Fixed set of worker threads running queued jobs in submission order
+class ThreadPool
+{
+public:
+    // nThreads of 0 uses one thread per hardware thread
+    explicit ThreadPool(int nThreads = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool & operator=(const ThreadPool &) = delete;
+
+    // Pool shared by the helpers, created on first use
+    static ThreadPool & shared();
+
+    // Queue job, returning a future for its result. Exceptions thrown by the job are
+    // rethrown from the future's get().
+    template <typename F>
+    std::future<std::invoke_result_t<F>> submit(F job) {
+        using Result = std::invoke_result_t<F>;
+        auto task = std::make_shared<std::packaged_task<Result()>>(std::move(job));
+        std::future<Result> result = task->get_future();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            jobs.push_back([task]() { (*task)(); });
+        }
+        wake.notify_one();
+        return result;
+    }
+
+    int size() const { return (int)workers.size(); }
+
+private:
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()>> jobs;
+    std::mutex mutex;
+    std::condition_variable wake;
+    bool stopping;
+
+    void run();
+};
@@ -68,6 +68,8 @@ Torus::Torus(GLfloat outerRadius, GLfloat innerRadius, GLuint nsides, GLuint nri
         }
     }
 
-    initBuffers(&el, &p, &n, &tex);
+    using Layout = VertexLayout<Position3f, Normal3f, UV2h>;
+    std::vector<GLubyte> verts = Layout::interleave(nVerts, p.data(), n.data(), tex.data());
+    initBuffers<Layout>(el.data(), (GLsizei)el.size(), verts.data(), nVerts);
 }
 
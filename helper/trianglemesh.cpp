@@ -1,5 +1,7 @@
 #include "trianglemesh.h"
 
+#include <cstring>
+
 void TriangleMesh::initBuffers(
         std::vector<GLuint> * indices,
         std::vector<GLfloat> * points,
@@ -10,6 +12,10 @@ void TriangleMesh::initBuffers(
 
     if( ! buffers.empty() ) deleteBuffers();
 
+    layout = nullptr;
+    layoutSize = 0;
+    layoutStride = 0;
+
     // Must have data for indices, points, and normals
     if( indices == nullptr || points == nullptr || normals == nullptr )
         return;
@@ -85,6 +91,70 @@ void TriangleMesh::render() const {
     glBindVertexArray(0);
 }
 
+void TriangleMesh::renderInstanced(const InstanceBuffer & instances) const {
+    if(vao == 0 || instances.getCount() == 0) return;
+
+    instances.bind();
+    glBindVertexArray(vao);
+    glDrawElementsInstanced(GL_TRIANGLES, nVerts, GL_UNSIGNED_INT, 0, instances.getCount());
+    glBindVertexArray(0);
+}
+
+void TriangleMesh::readBack(MeshData & data) const {
+    data = MeshData();
+    if( buffers.size() < 2 ) return;
+
+    auto read = [](GLuint buf, auto & dest) {
+        GLint size = 0;
+        glGetNamedBufferParameteriv(buf, GL_BUFFER_SIZE, &size);
+        dest.resize(size / sizeof(dest[0]));
+        glGetNamedBufferSubData(buf, 0, size, dest.data());
+    };
+
+    read(buffers[0], data.indices);
+
+    if( layout != nullptr ) {
+        // Split the interleaved buffer back into one float array per attribute
+        std::vector<GLubyte> verts;
+        read(buffers[1], verts);
+        size_t nPoints = verts.size() / layoutStride;
+
+        std::vector<GLfloat> * dest[] = { &data.points, &data.normals, &data.texCoords, &data.tangents };
+        for( GLuint a = 0; a < layoutSize; a++ ) {
+            const VertexAttribFormat & f = layout[a];
+            if( f.location > 3 ) continue;
+            std::vector<GLfloat> & attrib = *dest[f.location];
+            attrib.resize(nPoints * f.components);
+            for( size_t v = 0; v < nPoints; v++ ) {
+                const GLubyte * src = verts.data() + v * layoutStride + f.offset;
+                for( GLint c = 0; c < f.components; c++ ) {
+                    if( f.type == GL_HALF_FLOAT ) {
+                        GLushort h;
+                        memcpy(&h, src + c * sizeof(h), sizeof(h));
+                        attrib[v * f.components + c] = VertexFormat::halfToFloat(h);
+                    } else {
+                        memcpy(&attrib[v * f.components + c], src + c * sizeof(GLfloat), sizeof(GLfloat));
+                    }
+                }
+            }
+        }
+        return;
+    }
+
+    if( buffers.size() < 3 ) return;
+    read(buffers[1], data.points);
+    read(buffers[2], data.normals);
+
+    // Tex coords and tangents are both optional, so tell them apart by size
+    size_t nPoints = data.points.size() / 3;
+    for( size_t i = 3; i < buffers.size(); i++ ) {
+        std::vector<GLfloat> attrib;
+        read(buffers[i], attrib);
+        if( attrib.size() == nPoints * 2 ) data.texCoords = std::move(attrib);
+        else data.tangents = std::move(attrib);
+    }
+}
+
 TriangleMesh::~TriangleMesh() {
     deleteBuffers();
 }
@@ -4,9 +4,22 @@
 
 #include <glad/glad.h>
 #include "drawable.h"
+#include "instancebuffer.h"
+#include "vertexlayout.h"
 
 class TriangleMesh : public Drawable {
 
+public:
+    // CPU copy of a mesh in the layout taken by initBuffers
+    class MeshData {
+    public:
+        std::vector<GLuint> indices;
+        std::vector<GLfloat> points;
+        std::vector<GLfloat> normals;
+        std::vector<GLfloat> texCoords;
+        std::vector<GLfloat> tangents;
+    };
+
 protected:
 
     GLuint nVerts;     // Number of vertices
@@ -15,6 +28,12 @@ protected:
     // Vertex buffers
     std::vector<GLuint> buffers;
 
+    // Format of the interleaved vertex buffer, or null when each attribute has its own buffer
+    const VertexAttribFormat * layout;
+    GLuint layoutSize;
+    GLsizei layoutStride;
+
+    // Separate buffer per attribute, for meshes whose attributes are only known at runtime
     virtual void initBuffers(
             std::vector<GLuint> * indices,
             std::vector<GLfloat> * points,
@@ -23,15 +42,56 @@ protected:
             std::vector<GLfloat> * tangents = nullptr
             );
 
+    // Single interleaved vertex buffer in the format given by Layout (see vertexlayout.h)
+    template<typename Layout>
+    void initBuffers(const GLuint * indices, GLsizei nIndices, const void * vertices, GLsizei nVertices);
+
     virtual void deleteBuffers();
 
+    TriangleMesh() : nVerts(0), vao(0), layout(nullptr), layoutSize(0), layoutStride(0) { }
+
 public:
     virtual ~TriangleMesh();
     virtual void render() const;
+    virtual void renderInstanced(const InstanceBuffer & instances) const;
     GLuint getVao() const { return vao; }
-    GLuint getElementBuffer() { return buffers[0]; }
-    GLuint getPositionBuffer() { return buffers[1]; }
-    GLuint getNormalBuffer() { return buffers[2]; }
-    GLuint getTcBuffer() { if( buffers.size() > 3) return buffers[3]; else return 0; }
-    GLuint getNumVerts() { return nVerts; }
+    GLuint getElementBuffer() const { return buffers[0]; }
+    GLuint getPositionBuffer() const { return buffers[1]; }  // The interleaved buffer when the mesh has a layout
+    GLuint getNormalBuffer() const { if( layout == nullptr && buffers.size() > 2) return buffers[2]; else return 0; }
+    GLuint getTcBuffer() const { if( layout == nullptr && buffers.size() > 3) return buffers[3]; else return 0; }
+    GLuint getNumVerts() const { return nVerts; }
+
+    // Copy the mesh's buffers back from GL. Intended for load-time processing only.
+    void readBack(MeshData & data) const;
 };
+
+template<typename Layout>
+void TriangleMesh::initBuffers(const GLuint * indices, GLsizei nIndices, const void * vertices, GLsizei nVertices) {
+
+    if( ! buffers.empty() ) deleteBuffers();
+
+    nVerts = (GLuint)nIndices;
+    layout = Layout::formats.data();
+    layoutSize = (GLuint)Layout::count;
+    layoutStride = Layout::stride;
+
+    GLuint indexBuf = 0, vertexBuf = 0;
+    glGenBuffers(1, &indexBuf);
+    buffers.push_back(indexBuf);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuf);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, nIndices * sizeof(GLuint), indices, GL_STATIC_DRAW);
+
+    glGenBuffers(1, &vertexBuf);
+    buffers.push_back(vertexBuf);
+    glBindBuffer(GL_ARRAY_BUFFER, vertexBuf);
+    glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)nVertices * Layout::stride, vertices, GL_STATIC_DRAW);
+
+    glGenVertexArrays( 1, &vao );
+    glBindVertexArray(vao);
+
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuf);
+    glBindVertexBuffer(0, vertexBuf, 0, Layout::stride);
+    Layout::apply(0);
+
+    glBindVertexArray(0);
+}
@@ -0,0 +1,143 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+// Compile-time descriptions of interleaved vertex formats, e.g.
+//
+//     using Layout = VertexLayout<Position3f, Normal3f, UV2h>;
+//     std::vector<GLubyte> verts = Layout::interleave(nVerts, p.data(), n.data(), tc.data());
+//     initBuffers<Layout>(el.data(), (GLsizei)el.size(), verts.data(), nVerts);
+//
+// Stride and offsets are computed by the compiler, so a mesh uploads exactly the
+// attributes in its layout and nothing else.
+
+namespace VertexFormat {
+    // IEEE half precision conversion, rounding to nearest even
+    inline GLushort floatToHalf(float f) {
+        uint32_t x;
+        std::memcpy(&x, &f, sizeof(x));
+        uint32_t sign = (x >> 16) & 0x8000;
+        uint32_t absx = x & 0x7fffffff;
+
+        if( absx >= 0x7f800000 ) return (GLushort)(sign | 0x7c00 | (absx > 0x7f800000 ? 0x200 : 0)); // Inf/NaN
+        if( absx >= 0x477ff000 ) return (GLushort)(sign | 0x7c00);  // Too large, round to Inf
+        if( absx < 0x38800000 ) {
+            // Zero or subnormal half. Scale so the half mantissa is the integer part.
+            float af;
+            std::memcpy(&af, &absx, sizeof(af));
+            return (GLushort)(sign | (uint32_t)std::lrint(af * 16777216.0f));
+        }
+        // Rebias the exponent from 127 to 15 and round the mantissa
+        uint32_t bits = absx + 0xc8000fff + ((absx >> 13) & 1);
+        return (GLushort)(sign | (bits >> 13));
+    }
+
+    inline float halfToFloat(GLushort h) {
+        uint32_t sign = (uint32_t)(h & 0x8000) << 16;
+        uint32_t exp = (h >> 10) & 0x1f;
+        uint32_t mant = h & 0x3ff;
+
+        if( exp == 0 ) {
+            float f = mant / 16777216.0f;
+            return sign ? -f : f;
+        }
+
+        uint32_t bits = (exp == 31) ? (sign | 0x7f800000 | (mant << 13)) : (sign | ((exp + 112) << 23) | (mant << 13));
+        float f;
+        std::memcpy(&f, &bits, sizeof(f));
+        return f;
+    }
+}
+
+// Runtime view of one attribute of a layout, kept by meshes for readBack
+struct VertexAttribFormat {
+    GLuint location;
+    GLint components;
+    GLenum type;
+    GLboolean normalized;
+    GLuint offset;
+};
+
+// One attribute: shader location, component count and storage type. Source data is
+// always float and is converted when interleaving.
+template<GLuint Location, GLint Components, GLenum Type>
+struct VertexAttrib {
+    static_assert(Type == GL_FLOAT || Type == GL_HALF_FLOAT, "Only float and half float attributes are supported");
+
+    static constexpr GLuint location = Location;
+    static constexpr GLint components = Components;
+    static constexpr GLenum type = Type;
+    static constexpr GLboolean normalized = GL_FALSE;
+    static constexpr GLuint size = Components * (Type == GL_HALF_FLOAT ? 2 : 4);
+
+    static void write(GLubyte * dst, const GLfloat * src) {
+        for( GLint c = 0; c < Components; c++ ) {
+            if constexpr( Type == GL_HALF_FLOAT ) {
+                GLushort h = VertexFormat::floatToHalf(src[c]);
+                std::memcpy(dst + c * sizeof(h), &h, sizeof(h));
+            } else {
+                std::memcpy(dst + c * sizeof(GLfloat), &src[c], sizeof(GLfloat));
+            }
+        }
+    }
+};
+
+// The attributes used by the shaders in this project
+struct Position3f : VertexAttrib<0, 3, GL_FLOAT> {};
+struct Normal3f : VertexAttrib<1, 3, GL_FLOAT> {};
+struct UV2f : VertexAttrib<2, 2, GL_FLOAT> {};
+struct UV2h : VertexAttrib<2, 2, GL_HALF_FLOAT> {};
+struct Tangent4f : VertexAttrib<3, 4, GL_FLOAT> {};
+
+template<typename... Attribs>
+class VertexLayout {
+    template<typename> using Source = const GLfloat *;
+
+public:
+    static constexpr size_t count = sizeof...(Attribs);
+    static constexpr GLsizei stride = (Attribs::size + ... + 0);
+
+private:
+    static constexpr std::array<VertexAttribFormat, count> makeFormats() {
+        std::array<VertexAttribFormat, count> f{};
+        GLuint offset = 0;
+        size_t i = 0;
+        ((f[i++] = VertexAttribFormat{ Attribs::location, Attribs::components, Attribs::type, Attribs::normalized, offset },
+          offset += Attribs::size), ...);
+        return f;
+    }
+
+    template<size_t... I>
+    static void writeVertex(GLubyte * dst, size_t vert, const std::array<const GLfloat *, count> & src, std::index_sequence<I...>) {
+        (Attribs::write(dst + formats[I].offset, src[I] + vert * Attribs::components), ...);
+    }
+
+public:
+    static constexpr std::array<VertexAttribFormat, count> formats = makeFormats();
+
+    // Interleave one float array per attribute, in layout order
+    static std::vector<GLubyte> interleave(size_t nVerts, Source<Attribs>... sources) {
+        std::array<const GLfloat *, count> src = { sources... };
+        std::vector<GLubyte> data(nVerts * stride);
+        for( size_t v = 0; v < nVerts; v++ ) {
+            writeVertex(data.data() + v * stride, v, src, std::index_sequence_for<Attribs...>());
+        }
+        return data;
+    }
+
+    // Set up the attribute formats on the bound VAO, reading from vertex buffer binding point bindingIndex
+    static void apply(GLuint bindingIndex) {
+        for( const VertexAttribFormat & f : formats ) {
+            glEnableVertexAttribArray(f.location);
+            glVertexAttribFormat(f.location, f.components, f.type, f.normalized, f.offset);
+            glVertexAttribBinding(f.location, bindingIndex);
+        }
+    }
+};
@@ -0,0 +1,96 @@
+#include "vertexpool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+using std::cout;
+using std::endl;
+
+namespace {
+    // Pack a signed normalized value into the low bits of an integer field
+    GLuint packSnorm(float v, int bits) {
+        float maxVal = (float)((1 << (bits - 1)) - 1);
+        int i = (int)std::round(std::max(-1.0f, std::min(1.0f, v)) * maxVal);
+        return (GLuint)i & ((1u << bits) - 1);
+    }
+
+    GLuint pack1010102(float x, float y, float z, float w) {
+        return packSnorm(x, 10) | (packSnorm(y, 10) << 10) | (packSnorm(z, 10) << 20) | (packSnorm(w, 2) << 30);
+    }
+}
+
+VertexPool::VertexPool() : vao(0), vertexBuf(0), indexBuf(0)
+{ }
+
+VertexPool::~VertexPool() {
+    if( vertexBuf != 0 ) glDeleteBuffers(1, &vertexBuf);
+    if( indexBuf != 0 ) glDeleteBuffers(1, &indexBuf);
+    if( vao != 0 ) glDeleteVertexArrays(1, &vao);
+}
+
+VertexPool::Range VertexPool::add(const TriangleMesh & mesh) {
+    TriangleMesh::MeshData data;
+    mesh.readBack(data);
+
+    Range range;
+    range.indexCount = (GLsizei)data.indices.size();
+    range.firstIndex = (GLuint)indices.size();
+    range.baseVertex = (GLint)vertices.size();
+
+    size_t nPoints = data.points.size() / 3;
+    for( size_t i = 0; i < nPoints; i++ ) {
+        PackedVertex v = {};
+        v.px = data.points[i*3];
+        v.py = data.points[i*3+1];
+        v.pz = data.points[i*3+2];
+        if( !data.texCoords.empty() ) {
+            v.s = data.texCoords[i*2];
+            v.t = data.texCoords[i*2+1];
+        }
+        if( !data.normals.empty() ) {
+            v.normal = pack1010102(data.normals[i*3], data.normals[i*3+1], data.normals[i*3+2], 0.0f);
+        }
+        if( !data.tangents.empty() ) {
+            v.tangent = pack1010102(data.tangents[i*4], data.tangents[i*4+1], data.tangents[i*4+2], data.tangents[i*4+3]);
+        } else {
+            v.tangent = pack1010102(1.0f, 0.0f, 0.0f, 1.0f);
+        }
+        vertices.push_back(v);
+    }
+
+    indices.insert(indices.end(), data.indices.begin(), data.indices.end());
+
+    return range;
+}
+
+void VertexPool::build() {
+    cout << "Built vertex pool: vertices = " << vertices.size()
+         << " (" << (vertices.size() * sizeof(PackedVertex)) << " bytes)"
+         << " triangles = " << (indices.size() / 3) << endl;
+
+    glGenBuffers(1, &vertexBuf);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, vertexBuf);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, vertices.size() * sizeof(PackedVertex), vertices.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    // The VAO only holds the element buffer. No attribute arrays are enabled.
+    glGenVertexArrays(1, &vao);
+    glBindVertexArray(vao);
+    glGenBuffers(1, &indexBuf);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuf);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLuint), indices.data(), GL_STATIC_DRAW);
+    glBindVertexArray(0);
+
+    vertices = std::vector<PackedVertex>();
+    indices = std::vector<GLuint>();
+}
+
+void VertexPool::bind() const {
+    glBindVertexArray(vao);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, BINDING, vertexBuf);
+}
+
+void VertexPool::draw(const Range & range) const {
+    glDrawElementsBaseVertex(GL_TRIANGLES, range.indexCount, GL_UNSIGNED_INT,
+        (void *)(range.firstIndex * sizeof(GLuint)), range.baseVertex);
+}
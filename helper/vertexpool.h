@@ -0,0 +1,63 @@
+#pragma once
+
+#include "trianglemesh.h"
+#include <glad/glad.h>
+#include <vector>
+
+// Vertices of many meshes packed into one shader storage buffer, with their indices in
+// one shared element buffer, so every mesh draws from the same VAO. pbr.vert fetches
+// the vertex for gl_VertexID itself when VertexPulling is set, instead of using
+// fixed attribute locations.
+//
+// Packed vertex layout (std430, 32 bytes per vertex):
+//   float px, py, pz   position
+//   float s, t         texture coordinate (0 if the mesh has none)
+//   uint  normal       xyz as 10:10:10 snorm, bits 0-29
+//   uint  tangent      xyz as 10:10:10 snorm, handedness as a 2 bit snorm in bits 30-31
+//   uint  pad
+class VertexPool
+{
+public:
+    // Binding point of the VertexBuffer block in pbr.vert
+    static const GLuint BINDING = 1;
+
+    struct PackedVertex {
+        GLfloat px, py, pz;
+        GLfloat s, t;
+        GLuint normal;
+        GLuint tangent;
+        GLuint pad;
+    };
+
+    // Where a mesh lives in the pool. gl_VertexID includes baseVertex, so the shader
+    // indexes the vertex buffer directly.
+    struct Range {
+        GLsizei indexCount;
+        GLuint firstIndex;
+        GLint baseVertex;
+    };
+
+    VertexPool();
+    ~VertexPool();
+
+    // Make it non-copyable.
+    VertexPool(const VertexPool &) = delete;
+    VertexPool & operator=(const VertexPool &) = delete;
+
+    // Append a copy of a GL_TRIANGLES mesh. Must be called before build.
+    Range add(const TriangleMesh & mesh);
+
+    // Upload everything added so far and release the CPU copy
+    void build();
+
+    // Bind the shared VAO and vertex buffer. Draws then only differ by range.
+    void bind() const;
+    void draw(const Range & range) const;
+
+private:
+    GLuint vao;
+    GLuint vertexBuf, indexBuf;
+
+    std::vector<PackedVertex> vertices;
+    std::vector<GLuint> indices;
+};
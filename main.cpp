@@ -1,15 +1,55 @@
 #include "helper/scene.h"
 #include "helper/scenerunner.h"
 #include "scenebasic_uniform.h"
+#include "helper/teapot.h"
+#include "helper/hdrfile.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
 
 
 int main(int argc, char* argv[])
 {
+	// Run the teapot generation benchmark instead of the scene
+	if (argc > 1 && strcmp(argv[1], "--teapot-benchmark") == 0)
+	{
+		Teapot::benchmark();
+		return 0;
+	}
+
+	// Time the .hdr reader against stb_image on the files given, or else the sky box faces there are
+	if (argc > 1 && strcmp(argv[1], "--hdr-benchmark") == 0)
+	{
+		std::vector<std::string> files(argv + 2, argv + argc);
+		if (files.empty())
+		{
+			for (const char * baseName : { "media/overcast_skybox/overcast", "media/desert_skybox/desert" })
+			{
+				for (const char * suffix : { "posx", "negx", "posy", "negy", "posz", "negz" })
+				{
+					std::string face = std::string(baseName) + "_" + suffix + ".hdr";
+					if (std::filesystem::exists(face)) files.push_back(face);
+				}
+			}
+		}
+		HdrFile::benchmark(files);
+		return 0;
+	}
+
 	SceneRunner runner("Shader_Basics");
 
 	std::unique_ptr<Scene> scene;
 
-	scene = std::unique_ptr<Scene>(new SceneBasic_Uniform());
+	// Optional limit on streamed texture memory, in MB
+	size_t textureBudget = 0;
+	if (argc > 2 && strcmp(argv[1], "--texture-budget") == 0)
+	{
+		textureBudget = (size_t)std::max(0, atoi(argv[2])) << 20;
+	}
+
+	scene = std::unique_ptr<Scene>(new SceneBasic_Uniform(textureBudget));
 
 
 	return runner.run(*scene);
@@ -13,25 +13,32 @@ using std::endl;
 
 #include "helper/glutils.h"
 #include "helper/texture.h"
+#include "helper/frustum.h"
 
 #include "glad/glad.h"
 
 using namespace glm;
 
-SceneBasic_Uniform::SceneBasic_Uniform() :
-    plane(100.0f, 100.0f, 1, 1),
+SceneBasic_Uniform::SceneBasic_Uniform(size_t textureBudget) :
+    nParticles(10000), emitterPos(0, 50, 0), emitterDir(0, -1, 0), time(0), particleLifetime(30.3f),
+    vertexPullingEnabled(false), vertexPullingKeyLastFrame(false),
+    pass1Frame(0), pass1TimeSum(0.0), pass1TimeSamples(0),
+    teapotWireframe(false), teapotKeyLastFrame(false),
+    spotlight(vec4(0.0f, 0.0f, 10.0f, 1.0f), vec3(0.0f, 0.0f, 1.0f), vec3(2500.0f), 10.0f, 15.0f), // Starts at the camera, which is declared after it
+    textureFiltering(Texture::Filtering::Anisotropic), textureFilteringKeyLastFrame(false),
     tPrev(0), angle(0.0f), rotSpeed(pi<float>() / 8.0f),
     whiteLightsEnabled(true), bloomEnabled(true),
-    rightClickedLastFrame(false),
+    leftClickedLastFrame(false), rightClickedLastFrame(false),
     cameraPosition(0.0f, 0.0f, 10.0f), cameraForward(0.0f, 0.0f, 1.0f), cameraUp(0.0f, 1.0f, 0.0f),
     cameraYaw(-90.0f), cameraPitch(0.0f),
     cameraSpeed(5.0f), cameraSensitivity(0.025f),
     mouseFirstEntry(true), lastXPos(width / 2.0f), lastYPos(height / 2.0f),
-    spotlight(vec4(cameraPosition, 1.0), cameraForward, vec3(2500.0f), 10.0f, 15.0f),
-    time(0), particleLifetime(30.3f), nParticles(10000), emitterPos(0, 50, 0), emitterDir(0, -1, 0)
+    textureBudget(textureBudget),
+    packedOrmEnabled(true), packedOrmKeyLastFrame(false),
+    materialArraysEnabled(false), materialArraysKeyLastFrame(false),
+    srgbFramebuffer(false), srgbOutputEnabled(false), srgbOutputKeyLastFrame(false)
 {
     gun = ObjMesh::load("media/pistol-with-engravings/source/colt.obj", false, true);
-    target = ObjMesh::load("media/target/target.obj", false, true);
 }
 
 void SceneBasic_Uniform::initScene()
@@ -44,6 +51,17 @@ void SceneBasic_Uniform::initScene()
 
     glEnable(GL_DEPTH_TEST); // Enable depth testing
 
+    // Gamma encode the final pass with GL_FRAMEBUFFER_SRGB where the window has an sRGB capable
+    // framebuffer, otherwise hdrBloom.frag does it
+    GLint encoding = GL_LINEAR;
+    glGetNamedFramebufferAttachmentParameteriv(0, GL_BACK_LEFT, GL_FRAMEBUFFER_ATTACHMENT_COLOR_ENCODING, &encoding);
+    srgbFramebuffer = (encoding == GL_SRGB);
+    srgbOutputEnabled = srgbFramebuffer;
+    if (!srgbFramebuffer)
+    {
+        std::cout << "Default framebuffer isn't sRGB capable, gamma encoding in the shader" << std::endl;
+    }
+
     // Set MVP matrices
     model = mat4(1.0f);
     view = mat4(1.0f);
@@ -63,16 +81,42 @@ void SceneBasic_Uniform::initScene()
     hdrBloomProg.setUniform("White", 0.982f); // 0.982f // Ideally the luminance of the brightest parts of the image.
     hdrBloomProg.setUniform("Gamma", 2.2f);
     hdrBloomProg.setUniform("BloomEnabled", bloomEnabled);
+    hdrBloomProg.setUniform("SrgbOutput", srgbOutputEnabled);
 
     pbrProg.use();
-    pbrProg.setUniform("Gamma", 2.2f);
+    pbrProg.setUniform("Instanced", false);
+    pbrProg.setUniform("VertexPulling", vertexPullingEnabled);
+    pbrProg.setUniform("PackedOrm", packedOrmEnabled);
+    pbrProg.setUniform("MaterialArrays", materialArraysEnabled);
     pbrProg.setUniform("Fog.MinDist", 10.0f);
     pbrProg.setUniform("Fog.MaxDist", 15.0f);
     pbrProg.setUniform("Fog.Colour", vec3(0.0f));
 
+    // The teapot shares pbr.frag. Its light and camera uniforms are copied in drawTeapot().
+    teapotProg.use();
+    teapotProg.setUniform("PackedOrm", packedOrmEnabled);
+    teapotProg.setUniform("MaterialArrays", materialArraysEnabled);
+    teapotProg.setUniform("Fog.MinDist", 10.0f);
+    teapotProg.setUniform("Fog.MaxDist", 15.0f);
+    teapotProg.setUniform("Fog.Colour", vec3(0.0f));
+    teapotProg.setUniform("EdgePixels", 8.0f);
+
     // Setup skybox, gun textures
     setupTextures();
 
+    // Merge non-moving objects into world-space batches
+    setupStaticBatches();
+
+    // Copy PBR meshes into the shared vertex pulling buffers
+    setupVertexPool();
+
+    // Timer queries for pass 1
+    glGenQueries(2, pass1Queries);
+
+    // Bezier patches for GPU tessellation
+    teapot = std::make_unique<TeapotPatches>(mat4(1.0f));
+    glGenQueries(2, teapotQueries);
+
     // Setup FBO
     setupFBO();
 
@@ -105,12 +149,18 @@ void SceneBasic_Uniform::compile()
         // Particles shader
         particlesProg.compileShader("shader/particles.vert");
         particlesProg.compileShader("shader/particles.frag");
+        // Tessellated teapot shader
+        teapotProg.compileShader("shader/teapot.vert");
+        teapotProg.compileShader("shader/teapot.tcs");
+        teapotProg.compileShader("shader/teapot.tes");
+        teapotProg.compileShader("shader/pbr.frag");
 
         // Link Shaders
         skyboxProg.link();
         pbrProg.link();
         hdrBloomProg.link();
         particlesProg.link();
+        teapotProg.link();
 
         // Use pbr shader to begin
         pbrProg.use();
@@ -160,7 +210,7 @@ void SceneBasic_Uniform::setupParticles()
 
     // The particle texture
     glActiveTexture(GL_TEXTURE8);
-    particlesTexture = Texture::loadTexture("media/textures/rain_particle.png");
+    particlesTexture = Texture::loadTexture("media/textures/rain_particle.png", Texture::Options(true));
     glBindTexture(GL_TEXTURE_2D, particlesTexture);
 
     particlesProg.use();
@@ -172,51 +222,165 @@ void SceneBasic_Uniform::setupParticles()
 
 void SceneBasic_Uniform::setupTextures()
 {
-    // Load skybox texture
-    //GLuint skyboxTexture = Texture::loadHdrCubeMap("media/desert_skybox/desert");
-    GLuint skyboxTexture = Texture::loadHdrCubeMap("media/overcast_skybox/overcast");
-
-    // Load default textures
-    defaultAlbedoTexture = Texture::loadTexture("media/textures/grey_1x1.png");
-    defaultNormalTexture = Texture::loadTexture("media/textures/normal_up_1x1.png");
-    defaultMetallicTexture = Texture::loadTexture("media/textures/black_1x1.png");
-    defaultRoughnessTexture = Texture::loadTexture("media/textures/black_1x1.png");
-    defaultAOTexture = Texture::loadTexture("media/textures/white_1x1.png");
-
-    // Load gun textures
-    gunAlbedoTexture = Texture::loadTexture("media/pistol-with-engravings/textures/BaseColor.png");
-    gunNormalTexture = Texture::loadTexture("media/pistol-with-engravings/textures/Normal.png");
-    gunMetallicTexture = Texture::loadTexture("media/pistol-with-engravings/textures/Metallic.png");
-    gunRoughnessTexture = Texture::loadTexture("media/pistol-with-engravings/textures/Roughness.png");
-    gunAOTexture = Texture::loadTexture("media/textures/white_1x1.png");
-
-    // Load default textures
-    targetAlbedoTexture = Texture::loadTexture("media/target/textures/target_albedo.png");
-    targetNormalTexture = Texture::loadTexture("media/target/textures/target_normal.png");
-    targetMetallicTexture = defaultMetallicTexture;
-    targetRoughnessTexture = Texture::loadTexture("media/target/textures/target_roughness.png");
-    targetAOTexture = Texture::loadTexture("media/target/textures/target_AO.png");
-
-    // Set active texture unit and bind loaded texture ids to 2D texture buffer
-    bindPbrTextures(gunAlbedoTexture, gunNormalTexture, gunMetallicTexture, gunRoughnessTexture, gunAOTexture);
-
-    // Set texture unit to 0 and bind cubemap
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, skyboxTexture);
+    // Textures are streamed in over the first frames. Each texture name is valid straight
+    // away, but samples black until its data arrives. The registry shares repeated loads.
+    // Compressed maps start with their levels of 128x128 and smaller, and finer levels are
+    // loaded (and dropped again) as pbr.frag reports how closely each material is seen.
+    textureUploader = std::make_unique<TextureUploader>();
+    mipStreamer = std::make_unique<MipStreamer>();
+    mipStreamer->setBudget(textureBudget);
+    textureRegistry = std::make_unique<TextureRegistry>(textureUploader.get(), mipStreamer.get());
+
+    // Textures are lazy: nothing is read until the first frame that draws with them, and a
+    // placeholder is bound in their place until they arrive.
+    const TextureRegistry::Load lazy = TextureRegistry::Load::OnFirstUse;
+
+    // Load skybox texture. Shared exponent storage is a third the size of the float source.
+    // Skies shipped as one equirectangular image load through loadEquirectCubeMap() instead.
+    skyboxTexture = textureRegistry->loadHdrCubeMap("media/overcast_skybox/overcast", Texture::HdrFormat::RGB9E5, lazy);
+
+    // PBR maps are block compressed, cooked to KTX2 on first load
+    const Texture::Options albedoOptions(true, Texture::Compression::BC7);
+    const Texture::Options normalOptions(false, Texture::Compression::BC5);
+    const Texture::Options singleOptions(false, Texture::Compression::BC4);
+    const Texture::Options ormOptions(false, Texture::Compression::BC7);
+
+    // Each material's albedo, normal, metallic, roughness and AO maps, and the ORM image the last three are packed into.
+    // Channels without detail are constants instead, so their maps aren't loaded or sampled. The 1x1 images
+    // standing in for them are only read to pack the ORM image.
+    using Constants = MaterialTable::Constants;
+    struct MaterialMaps
+    {
+        PbrMaterial * material;
+        string albedo, normal, metallic, roughness, ao, orm;
+        Constants constants;
+    };
+    const MaterialMaps materials[] = {
+        // Mid grey (sRGB 128, 0.216 linear), flat, smooth and non-metallic, with no maps at all
+        { &defaultMaterial, "", "", "", "", "", "",
+          Constants(Constants::ALL, vec3(0.216f), 1.0f, 0.0f, 0.0f) },
+        { &gunMaterial, "media/pistol-with-engravings/textures/BaseColor.png", "media/pistol-with-engravings/textures/Normal.png",
+          "media/pistol-with-engravings/textures/Metallic.png", "media/pistol-with-engravings/textures/Roughness.png",
+          "media/textures/white_1x1.png", "media/pistol-with-engravings/textures/pistol.orm.png",
+          Constants(Constants::AO, vec3(0.0f), 1.0f) },
+        { &targetMaterial, "media/target/textures/target_albedo.png", "media/target/textures/target_normal.png",
+          "media/textures/black_1x1.png", "media/target/textures/target_roughness.png",
+          "media/target/textures/target_AO.png", "media/target/textures/target.orm.png",
+          Constants(Constants::METALLIC, vec3(0.0f), 1.0f, 0.0f, 0.0f) },
+    };
+
+    // The material arrays are built first, cooking any maps that are out of date, so the streamed
+    // loads only read cooked files. Their layers are uploaded as each material is first drawn.
+    // ORM images are packed once, then only when a map changes.
+    for (const MaterialMaps & maps : materials)
+    {
+        if (!maps.constants.has(Constants::ORM))
+        {
+            Texture::packOrm(maps.ao, maps.roughness, maps.metallic, maps.orm);
+        }
+        maps.material->constants = maps.constants;
+        maps.material->index = materialTable.add({ maps.albedo, albedoOptions }, { maps.normal, normalOptions }, { maps.orm, ormOptions },
+                                                 maps.constants);
+    }
+    materialTable.build();
+    materialTable.bind();
+
+    // The same maps as separate textures, for comparison. They only load once bound.
+    for (const MaterialMaps & maps : materials)
+    {
+        PbrMaterial & material = *maps.material;
+        auto load = [&](const string & fName, const Texture::Options & options, GLuint channel) {
+            return material.constants.has(channel) ? TextureRegistry::Handle() : textureRegistry->load(fName, options, lazy);
+        };
+        material.albedo = load(maps.albedo, albedoOptions, Constants::ALBEDO);
+        material.normal = load(maps.normal, normalOptions, Constants::NORMAL);
+        material.metallic = load(maps.metallic, singleOptions, Constants::METALLIC);
+        material.roughness = load(maps.roughness, singleOptions, Constants::ROUGHNESS);
+        material.ao = load(maps.ao, singleOptions, Constants::AO);
+        material.orm = load(maps.orm, ormOptions, Constants::ORM);
+    }
+}
+
+void SceneBasic_Uniform::setupStaticBatches()
+{
+    // Ground. Tiles are picked per frame, so it isn't batched
+    ground = std::make_unique<ChunkedGround>(2048.0f, 8.0f, 8, -5.0f);
+
+    // Target
+    std::unique_ptr<ObjMesh> target = ObjMesh::load("media/target/target.obj", false, true, true);
+    targetModel = mat4(1.0f);
+    targetModel = translate(targetModel, vec3(0.0f, -4.0f, 0.0f));
+    targetModel = scale(targetModel, vec3(2.0f));
+    targetBatch.add(*target, targetModel);
+    targetCollision = target->getCollisionMesh(); // Outlives the GL mesh, which is freed once batched
+    targetBatch.build();
+
+    // Floor gun
+    mat4 floorGunModel = mat4(1.0f);
+    floorGunModel = translate(floorGunModel, 4.5f * vec3(0.0f, -1.0f, 0.0f));
+    floorGunModel = translate(floorGunModel, vec3(5.0f, 0.0f, 0.0f));
+    floorGunModel = rotate(floorGunModel, radians(90.0f), vec3(1.0f, 0.0f, 0.0f));
+    floorGunModel = scale(floorGunModel, vec3(0.2f));
+    floorGunBatch.add(*gun, floorGunModel);
+    floorGunBatch.build();
+}
+
+void SceneBasic_Uniform::setupVertexPool()
+{
+    gunRange = vertexPool.add(*gun);
+    targetRange = vertexPool.add(targetBatch);
+    floorGunRange = vertexPool.add(floorGunBatch);
+    vertexPool.build();
 }
 
-void SceneBasic_Uniform::bindPbrTextures(GLuint albedo, GLuint normal, GLuint metallic, GLuint roughness, GLuint ao)
+void SceneBasic_Uniform::drawMesh(const TriangleMesh & mesh, const VertexPool::Range & range)
 {
-    glActiveTexture(GL_TEXTURE3);
-    glBindTexture(GL_TEXTURE_2D, albedo);
-    glActiveTexture(GL_TEXTURE4);
-    glBindTexture(GL_TEXTURE_2D, normal);
-    glActiveTexture(GL_TEXTURE5);
-    glBindTexture(GL_TEXTURE_2D, metallic);
-    glActiveTexture(GL_TEXTURE6);
-    glBindTexture(GL_TEXTURE_2D, roughness);
-    glActiveTexture(GL_TEXTURE7);
-    glBindTexture(GL_TEXTURE_2D, ao);
+    if (vertexPullingEnabled)
+    {
+        vertexPool.bind();
+        vertexPool.draw(range);
+        glBindVertexArray(0);
+    }
+    else
+    {
+        mesh.render();
+    }
+}
+
+void SceneBasic_Uniform::bindPbrTextures(GLSLProgram & prog, const PbrMaterial & material)
+{
+    // Picks the material's array layers, or its mip feedback slot when binding separate textures
+    prog.setUniform("MaterialIndex", material.index);
+    if (materialArraysEnabled)
+    {
+        // Already bound, so only the index changes. The first bind starts its layers loading.
+        materialTable.request(material.index);
+        return;
+    }
+
+    // Constant channels aren't sampled, so have nothing to bind
+    const MaterialTable::Constants & constants = material.constants;
+    prog.setUniform("ConstantChannels", constants.channels);
+    prog.setUniform("ConstantAlbedo", constants.albedo);
+    prog.setUniform("ConstantOrm", vec3(constants.ao, constants.roughness, constants.metallic));
+
+    // The first bind starts a map loading. Each map then follows the mip feedback of every material binding it.
+    auto bind = [this, &material](GLenum unit, const TextureRegistry::Handle & map) {
+        if (!map) return;
+        glActiveTexture(unit);
+        glBindTexture(GL_TEXTURE_2D, map->use());
+        mipStreamer->addSlot(map->id(), material.index);
+    };
+    bind(GL_TEXTURE3, material.albedo);
+    bind(GL_TEXTURE4, material.normal);
+    if (packedOrmEnabled)
+    {
+        bind(GL_TEXTURE5, material.orm);
+        return;
+    }
+    bind(GL_TEXTURE5, material.metallic);
+    bind(GL_TEXTURE6, material.roughness);
+    bind(GL_TEXTURE7, material.ao);
 }
 
 void SceneBasic_Uniform::initBuffers()
@@ -390,34 +554,21 @@ void SceneBasic_Uniform::setupBlurFBO()
 
 void SceneBasic_Uniform::setupFullscreenQuad()
 {
-    // Array for full-screen quad
-    GLfloat verts[] = {
-    -1.0f, -1.0f, 0.0f, 1.0f, -1.0f, 0.0f, 1.0f, 1.0f, 0.0f,
-    -1.0f, -1.0f, 0.0f, 1.0f, 1.0f, 0.0f, -1.0f, 1.0f, 0.0f
-    };
-
-    GLfloat tc[] = {
-    0.0f, 0.0f, 1.0f, 0.0f, 1.0f, 1.0f,
-    0.0f, 0.0f, 1.0f, 1.0f, 0.0f, 1.0f
-    };
-
-    // Set up the buffers
-    unsigned int handle[2];
-    glGenBuffers(2, handle);
-    glBindBuffer(GL_ARRAY_BUFFER, handle[0]);
-    glBufferData(GL_ARRAY_BUFFER, 6 * 3 * sizeof(float), verts, GL_STATIC_DRAW);
-    glBindBuffer(GL_ARRAY_BUFFER, handle[1]);
-    glBufferData(GL_ARRAY_BUFFER, 6 * 2 * sizeof(float), tc, GL_STATIC_DRAW);
+    // Full-screen quad, interleaved positions and tex coords baked into static storage
+    const auto & verts = Primitives::fullscreenQuad;
+
+    // Set up the buffer
+    GLuint handle;
+    glGenBuffers(1, &handle);
+    glBindBuffer(GL_ARRAY_BUFFER, handle);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(verts), verts.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
 
     // Set up the vertex array object
     glGenVertexArrays(1, &fsQuad);
     glBindVertexArray(fsQuad);
-    glBindBuffer(GL_ARRAY_BUFFER, handle[0]);
-    glVertexAttribPointer((GLuint)0, 3, GL_FLOAT, GL_FALSE, 0, 0);
-    glEnableVertexAttribArray(0); // Vertex position
-    glBindBuffer(GL_ARRAY_BUFFER, handle[1]);
-    glVertexAttribPointer((GLuint)2, 2, GL_FLOAT, GL_FALSE, 0, 0);
-    glEnableVertexAttribArray(2); // Texture coordinates
+    glBindVertexBuffer(0, handle, 0, Primitives::QuadLayout::stride);
+    Primitives::QuadLayout::apply(0); // Vertex position and texture coordinates
     glBindVertexArray(0);
 }
 
@@ -479,6 +630,18 @@ void SceneBasic_Uniform::setupSamplers()
     //glBindSampler(0, linearSampler);
     //glBindSampler(1, linearSampler);
     //glBindSampler(2, linearSampler);
+
+    // Set up the PBR map sampler. Wraps, and uses the mip chains built on load
+    glGenSamplers(1, &pbrSampler);
+    Texture::setSamplerFiltering(pbrSampler, textureFiltering);
+    for (GLuint unit = 3; unit <= 7; unit++)
+    {
+        glBindSampler(unit, pbrSampler);
+    }
+    for (GLuint unit = MaterialTable::FIRST_UNIT; unit < MaterialTable::FIRST_UNIT + MaterialTable::MAX_ARRAYS; unit++)
+    {
+        glBindSampler(unit, pbrSampler);
+    }
 }
 
 void SceneBasic_Uniform::update( float t )
@@ -543,6 +706,91 @@ void SceneBasic_Uniform::handleKeyboardInput(GLFWwindow* windowContext, float de
         hdrBloomProg.use();
         hdrBloomProg.setUniform("BloomEnabled", bloomEnabled);
     }
+    if (glfwGetKey(windowContext, GLFW_KEY_4) == GLFW_PRESS && !vertexPullingKeyLastFrame) // Toggle vertex pulling
+    {
+        vertexPullingKeyLastFrame = true;
+        vertexPullingEnabled = !vertexPullingEnabled;
+        pbrProg.use();
+        pbrProg.setUniform("VertexPulling", vertexPullingEnabled);
+
+        // Start timing the new path from scratch
+        pass1TimeSum = 0.0;
+        pass1TimeSamples = 0;
+    }
+    else if (glfwGetKey(windowContext, GLFW_KEY_4) == GLFW_RELEASE)
+    {
+        vertexPullingKeyLastFrame = false;
+    }
+    if (glfwGetKey(windowContext, GLFW_KEY_6) == GLFW_PRESS && !textureFilteringKeyLastFrame) // Cycle PBR texture filtering
+    {
+        textureFilteringKeyLastFrame = true;
+        textureFiltering = (Texture::Filtering)(((int)textureFiltering + 1) % 3);
+        Texture::setSamplerFiltering(pbrSampler, textureFiltering);
+        std::cout << "Texture filtering: " << Texture::filteringName(textureFiltering) << std::endl;
+
+        // Start timing the new filtering from scratch
+        pass1TimeSum = 0.0;
+        pass1TimeSamples = 0;
+    }
+    else if (glfwGetKey(windowContext, GLFW_KEY_6) == GLFW_RELEASE)
+    {
+        textureFilteringKeyLastFrame = false;
+    }
+    if (glfwGetKey(windowContext, GLFW_KEY_7) == GLFW_PRESS && !packedOrmKeyLastFrame) // Toggle packed ORM textures
+    {
+        packedOrmKeyLastFrame = true;
+        packedOrmEnabled = !packedOrmEnabled;
+        pbrProg.use();
+        pbrProg.setUniform("PackedOrm", packedOrmEnabled);
+        teapotProg.use();
+        teapotProg.setUniform("PackedOrm", packedOrmEnabled);
+
+        // Start timing the new path from scratch
+        pass1TimeSum = 0.0;
+        pass1TimeSamples = 0;
+    }
+    else if (glfwGetKey(windowContext, GLFW_KEY_7) == GLFW_RELEASE)
+    {
+        packedOrmKeyLastFrame = false;
+    }
+    if (glfwGetKey(windowContext, GLFW_KEY_8) == GLFW_PRESS && !materialArraysKeyLastFrame) // Toggle material texture arrays
+    {
+        materialArraysKeyLastFrame = true;
+        materialArraysEnabled = !materialArraysEnabled;
+        pbrProg.use();
+        pbrProg.setUniform("MaterialArrays", materialArraysEnabled);
+        teapotProg.use();
+        teapotProg.setUniform("MaterialArrays", materialArraysEnabled);
+
+        // Start timing the new path from scratch
+        pass1TimeSum = 0.0;
+        pass1TimeSamples = 0;
+    }
+    else if (glfwGetKey(windowContext, GLFW_KEY_8) == GLFW_RELEASE)
+    {
+        materialArraysKeyLastFrame = false;
+    }
+    if (glfwGetKey(windowContext, GLFW_KEY_9) == GLFW_PRESS && !srgbOutputKeyLastFrame && srgbFramebuffer) // Toggle sRGB framebuffer output
+    {
+        srgbOutputKeyLastFrame = true;
+        srgbOutputEnabled = !srgbOutputEnabled;
+        hdrBloomProg.use();
+        hdrBloomProg.setUniform("SrgbOutput", srgbOutputEnabled);
+        std::cout << "Gamma encoding: " << (srgbOutputEnabled ? "sRGB framebuffer" : "shader") << std::endl;
+    }
+    else if (glfwGetKey(windowContext, GLFW_KEY_9) == GLFW_RELEASE)
+    {
+        srgbOutputKeyLastFrame = false;
+    }
+    if (glfwGetKey(windowContext, GLFW_KEY_5) == GLFW_PRESS && !teapotKeyLastFrame) // Toggle teapot wireframe
+    {
+        teapotKeyLastFrame = true;
+        teapotWireframe = !teapotWireframe;
+    }
+    else if (glfwGetKey(windowContext, GLFW_KEY_5) == GLFW_RELEASE)
+    {
+        teapotKeyLastFrame = false;
+    }
 }
 
 void SceneBasic_Uniform::handleMouseMovement(GLFWwindow* windowContext, float deltaTime)
@@ -594,9 +842,16 @@ void SceneBasic_Uniform::handleMouseMovement(GLFWwindow* windowContext, float de
 
 void SceneBasic_Uniform::handleMouseClicks(GLFWwindow* windowContext)
 {
-    if (glfwGetMouseButton(windowContext, GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS)
+    if (glfwGetMouseButton(windowContext, GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS && !leftClickedLastFrame)
     {
+        leftClickedLastFrame = true;
+
         // Shoot bullet
+        shootBullet();
+    }
+    else if (glfwGetMouseButton(windowContext, GLFW_MOUSE_BUTTON_LEFT) == GLFW_RELEASE)
+    {
+        leftClickedLastFrame = false;
     }
     if (glfwGetMouseButton(windowContext, GLFW_MOUSE_BUTTON_RIGHT) == GLFW_PRESS && !rightClickedLastFrame)
     {
@@ -612,8 +867,39 @@ void SceneBasic_Uniform::handleMouseClicks(GLFWwindow* windowContext)
     }
 }
 
+void SceneBasic_Uniform::shootBullet()
+{
+    if (!targetCollision) return;
+
+    // Cast the ray in the target's object space rather than transforming every triangle.
+    // The direction isn't renormalized, so the hit distance comes back in world units.
+    const float range = 100.0f;
+    mat4 worldToTarget = inverse(targetModel);
+    vec3 origin = vec3(worldToTarget * vec4(cameraPosition, 1.0f));
+    vec3 dir = mat3(worldToTarget) * cameraForward;
+
+    float hitDist;
+    if (targetCollision->raycast(origin, dir, range, hitDist))
+    {
+        std::cout << "Hit target at distance " << hitDist << std::endl;
+    }
+    else
+    {
+        std::cout << "Missed" << std::endl;
+    }
+}
+
 void SceneBasic_Uniform::render()
 {
+    textureUploader->update();
+
+    // The budget covers every registry texture and the material arrays. Those the streamer
+    // can't evict, like the sky box, leave less room for streamed levels.
+    size_t registryBytes = textureRegistry->residentBytes(), streamedBytes = mipStreamer->residentBytes();
+    mipStreamer->setFixedBytes((registryBytes > streamedBytes ? registryBytes - streamedBytes : 0) + materialTable.residentBytes());
+    mipStreamer->update();
+    materialTable.update();
+
     pass1();
     computeLogAveLuminance();
     pass2();
@@ -663,34 +949,43 @@ void SceneBasic_Uniform::drawScene()
     view = lookAt(vec3(0.0f), cameraForward, cameraUp); // For infinite skybox
 
     setMatrices(skyboxProg);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, skyboxTexture->use());
     skybox.render();
 
     view = prevView; // Back to normal
 
-    // Plane rendering
+    // Static batch rendering. Batches are already in world space
     pbrProg.use();
 
     // Set camera position
     pbrProg.setUniform("CameraPos", view * vec4(cameraPosition, 1.0f));
 
-    // Set plane model matrix
     model = mat4(1.0f);
-    model = translate(model, vec3(0.0f, -5.0f, 0.0f));
-
-    // Bind default, set MVP matrix uniforms and render plane
-    bindPbrTextures(defaultAlbedoTexture, defaultNormalTexture, defaultMetallicTexture, defaultRoughnessTexture, defaultAOTexture);
     setMatrices(pbrProg);
-    plane.render();
 
-    // Target rendering
-    // Bind textures, set MVP matrix uniforms and render target
-    model = mat4(1.0f);
-    model = translate(model, vec3(0.0f, -4.0f, 0.0f));
-    model = scale(model, vec3(2.0f));
+    // Bind default textures and render ground. Its tiles always use vertex attributes
+    bindPbrTextures(pbrProg, defaultMaterial);
+    pbrProg.setUniform("VertexPulling", false);
+    ground->update(cameraPosition, projection * view);
+    ground->render([this](const mat4 & tileModel) {
+        model = tileModel;
+        setMatrices(pbrProg);
+    });
+    pbrProg.setUniform("VertexPulling", vertexPullingEnabled);
 
-    bindPbrTextures(targetAlbedoTexture, targetNormalTexture, targetMetallicTexture, targetRoughnessTexture, targetAOTexture);
+    model = mat4(1.0f);
     setMatrices(pbrProg);
-    target->render();
+
+    // Batches off screen are skipped, so their textures don't load until they are first seen
+    Frustum frustum(projection * view);
+
+    // Bind target textures and render target
+    if (frustum.intersects(targetBatch.getBounds()))
+    {
+        bindPbrTextures(pbrProg, targetMaterial);
+        drawMesh(targetBatch, targetRange);
+    }
 
     // Particles rendering
     model = mat4(1.0f);
@@ -724,27 +1019,47 @@ void SceneBasic_Uniform::drawScene()
     model = translate(model, 5.0f * vec3(0.0f, -1.0f, 0.0f));
 
     // Bind gun textures, set MVP matrix uniforms and render gun
-    bindPbrTextures(gunAlbedoTexture, gunNormalTexture, gunMetallicTexture, gunRoughnessTexture, gunAOTexture);
+    bindPbrTextures(pbrProg, gunMaterial);
     setMatrices(pbrProg);
-    gun->render();
+    drawMesh(*gun, gunRange);
 
-    // Floor gun rendering
-    pbrProg.use();
+    // Floor gun rendering. Shares the gun textures that are still bound
+    if (frustum.intersects(floorGunBatch.getBounds()))
+    {
+        model = mat4(1.0f);
+        setMatrices(pbrProg);
+        drawMesh(floorGunBatch, floorGunRange);
+    }
 
-    // Set camera position
-    pbrProg.setUniform("CameraPos", view * vec4(cameraPosition, 1.0f));
+    drawTeapot();
+}
 
-    // Set gun model matrix
+void SceneBasic_Uniform::drawTeapot()
+{
+    // Same lighting as the pbr shader, so copy over its per-frame uniforms
+    teapotProg.use();
+    teapotProg.setUniform("Spotlight.Position", view * spotlight.getPosition());
+    teapotProg.setUniform("Spotlight.Direction", vec3(view * vec4(spotlight.getDirection(), 0.0f)));
+    teapotProg.setUniform("Spotlight.L", spotlight.getIntensity());
+    teapotProg.setUniform("Spotlight.InnerCutoff", spotlight.getInnerCutoff());
+    teapotProg.setUniform("Spotlight.OuterCutoff", spotlight.getOuterCutoff());
+    teapotProg.setUniform("CameraPos", view * vec4(cameraPosition, 1.0f));
+    teapotProg.setUniform("ViewportSize", vec2((float)width, (float)height));
+
+    // Teapot data is z-up, so stand it on the ground
     model = mat4(1.0f);
-    model = translate(model, 4.5f * vec3(0.0f, -1.0f, 0.0f));
-    model = translate(model, vec3(5.0f, 0.0f, 0.0f));
-    model = rotate(model, radians(90.0f), vec3(1.0f, 0.0f, 0.0f));
-    model = scale(model, vec3(0.2f));
-
-    // Bind gun textures, set MVP matrix uniforms and render gun
-    bindPbrTextures(gunAlbedoTexture, gunNormalTexture, gunMetallicTexture, gunRoughnessTexture, gunAOTexture);
-    setMatrices(pbrProg);
-    gun->render();
+    model = translate(model, vec3(-4.0f, -5.0f, 3.0f));
+    model = rotate(model, radians(-90.0f), vec3(1.0f, 0.0f, 0.0f));
+    model = scale(model, vec3(0.5f));
+    setMatrices(teapotProg);
+
+    bindPbrTextures(teapotProg, defaultMaterial);
+
+    if (teapotWireframe) glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+    glBeginQuery(GL_PRIMITIVES_GENERATED, teapotQueries[pass1Frame % 2]);
+    teapot->render();
+    glEndQuery(GL_PRIMITIVES_GENERATED);
+    glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
 }
 
 void SceneBasic_Uniform::pass1() // Draw the scene normally
@@ -759,7 +1074,45 @@ void SceneBasic_Uniform::pass1() // Draw the scene normally
     view = lookAt(cameraPosition, cameraPosition + cameraForward, cameraUp);
     projection = glm::perspective(glm::radians(70.0f), (float)width / height, 0.3f, 1000.0f);
 
+    glBeginQuery(GL_TIME_ELAPSED, pass1Queries[pass1Frame % 2]);
     drawScene();
+    glEndQuery(GL_TIME_ELAPSED);
+    recordPass1Time();
+}
+
+void SceneBasic_Uniform::recordPass1Time()
+{
+    // Read last frame's query, so this frame's doesn't stall the pipeline
+    pass1Frame++;
+    if (pass1Frame < 2) return;
+
+    GLuint64 elapsed = 0;
+    glGetQueryObjectui64v(pass1Queries[pass1Frame % 2], GL_QUERY_RESULT, &elapsed);
+    pass1TimeSum += elapsed / 1.0e6;
+    pass1TimeSamples++;
+
+    if (pass1TimeSamples == 300)
+    {
+        std::cout << "Pass 1 (" << (vertexPullingEnabled ? "vertex pulling" : "vertex attributes") << ", "
+                  << Texture::filteringName(textureFiltering) << " filtering, "
+                  << (materialArraysEnabled ? "material arrays" : packedOrmEnabled ? "packed ORM" : "separate ORM maps") << "): "
+                  << (pass1TimeSum / pass1TimeSamples) << " ms average over " << pass1TimeSamples << " frames" << std::endl;
+
+        GLuint teapotTriangles = 0;
+        glGetQueryObjectuiv(teapotQueries[pass1Frame % 2], GL_QUERY_RESULT, &teapotTriangles);
+        std::cout << "Tessellated teapot: " << teapotTriangles << " triangles" << std::endl;
+        std::cout << "Textures: " << textureRegistry->size() << " resident, "
+                  << textureRegistry->residentBytes() / 1024 << " KB" << std::endl;
+        const MipStreamer::Stats & mips = mipStreamer->stats();
+        std::cout << "Mip streaming: " << mipStreamer->residentBytes() / 1024 << " KB of "
+                  << mipStreamer->fullBytes() / 1024 << " KB resident";
+        if (textureBudget != 0) std::cout << " (budget " << textureBudget / 1024 << " KB)";
+        std::cout << ", " << mips.hits << " hits, " << mips.misses << " misses, " << mips.loadedLevels << " levels loaded ("
+                  << mips.reloadedLevels << " reloaded), " << mips.evictedLevels << " evicted, "
+                  << mips.releasedLevels << " released unused" << std::endl;
+        pass1TimeSum = 0.0;
+        pass1TimeSamples = 0;
+    }
 }
 
 void SceneBasic_Uniform::computeLogAveLuminance()
@@ -837,11 +1190,19 @@ void SceneBasic_Uniform::pass5()
     glClear(GL_COLOR_BUFFER_BIT);
     glViewport(0, 0, width, height);
 
+    // Let the ROP do the gamma encoding
+    if (srgbOutputEnabled)
+    {
+        glEnable(GL_FRAMEBUFFER_SRGB);
+    }
+
     glBindSampler(1, linearSampler);
     glBindVertexArray(fsQuad);
     glDrawArrays(GL_TRIANGLES, 0, 6);
     glBindVertexArray(0);
     glBindSampler(1, nearestSampler);
+
+    glDisable(GL_FRAMEBUFFER_SRGB);
 }
 
 void SceneBasic_Uniform::resize(int w, int h)
@@ -12,30 +12,65 @@
 #include <glm/gtc/matrix_transform.hpp>
 // Helper files
 #include "helper/plane.h"
+#include "helper/geometrycache.h"
+#include "helper/chunkedground.h"
 #include "helper/objmesh.h"
+#include "helper/staticbatch.h"
+#include "helper/vertexpool.h"
 #include "helper/skybox.h"
+#include "helper/teapotpatches.h"
 #include "helper/random.h"
+#include "helper/texture.h"
+#include "helper/textureuploader.h"
+#include "helper/textureregistry.h"
+#include "helper/mipstreamer.h"
+#include "helper/materialtable.h"
 #include "helper/particleutils.h"
 #include "Spotlight.h"
 
 class SceneBasic_Uniform : public Scene
 {
 private:
-    GLSLProgram hdrBloomProg, pbrProg, skyboxProg, particlesProg;
+    GLSLProgram hdrBloomProg, pbrProg, skyboxProg, particlesProg, teapotProg;
 
     Random rand;
     GLuint initPos, initVel, startTime, particles, nParticles;
     vec3 emitterPos, emitterDir;
     float time, particleLifetime;
 
-    std::unique_ptr<ObjMesh> gun, target;
-    Plane plane;
-    SkyBox skybox;
+    std::unique_ptr<ObjMesh> gun;
+    StaticBatch targetBatch, floorGunBatch; // Non-moving objects, one batch per material
+    std::unique_ptr<ChunkedGround> ground;
+
+    // CPU copy of the target for shooting, in the target's object space
+    std::shared_ptr<const CollisionMesh> targetCollision;
+    mat4 targetModel;
+
+    // Vertex pulling path. All PBR meshes also live in one pool drawn from a single VAO
+    VertexPool vertexPool;
+    VertexPool::Range gunRange, targetRange, floorGunRange;
+    bool vertexPullingEnabled, vertexPullingKeyLastFrame;
+
+    // GPU timing of pass 1, for comparing the vertex pulling and attribute paths
+    GLuint pass1Queries[2];
+    int pass1Frame;
+    double pass1TimeSum;
+    int pass1TimeSamples;
+
+    // Teapot tessellated on the GPU, with a primitives generated query per frame
+    std::unique_ptr<TeapotPatches> teapot;
+    GLuint teapotQueries[2];
+    bool teapotWireframe, teapotKeyLastFrame;
+
+    SkyBox<> skybox;
     Spotlight spotlight;
 
     // FBOs, textures and samplers
     GLuint fsQuad, hdrFbo, blurFbo, hdrTex, tex1, tex2;
     GLuint linearSampler, nearestSampler;
+    GLuint pbrSampler; // Units 3-7 and 9-17, the PBR maps and material arrays
+    Texture::Filtering textureFiltering;
+    bool textureFilteringKeyLastFrame;
     int bloomBufWidth, bloomBufHeight;
 
     float tPrev;
@@ -43,7 +78,7 @@ private:
     float rotSpeed;
 
     bool whiteLightsEnabled, bloomEnabled;
-    bool rightClickedLastFrame;
+    bool leftClickedLastFrame, rightClickedLastFrame;
 
     // Mouse variables
     glm::vec3 cameraPosition, cameraForward, cameraUp; // Relative position within world space
@@ -57,14 +92,35 @@ private:
     float lastXPos;
     float lastYPos;
 
-    // Default textures
-    GLuint defaultAlbedoTexture, defaultNormalTexture, defaultMetallicTexture, defaultRoughnessTexture, defaultAOTexture;
-
-    // Gun textures
-    GLuint gunAlbedoTexture, gunNormalTexture, gunMetallicTexture, gunRoughnessTexture, gunAOTexture;
-
-    // Target textures
-    GLuint targetAlbedoTexture, targetNormalTexture, targetMetallicTexture, targetRoughnessTexture, targetAOTexture;
+    // Streams the sky box in over the first frames, and the PBR maps' mip levels as they're
+    // needed on screen. Declared before the textures, so they outlive them.
+    std::unique_ptr<TextureUploader> textureUploader;
+    std::unique_ptr<MipStreamer> mipStreamer;
+    size_t textureBudget; // For all PBR and sky box textures, met by evicting streamed mip levels. 0 for no limit
+    std::unique_ptr<TextureRegistry> textureRegistry;
+
+    TextureRegistry::Handle skyboxTexture;
+
+    // PBR maps for one material. The packed ORM texture holds the AO, roughness and metallic
+    // maps, and is bound in their place unless comparing against the separate maps.
+    // Maps of constant channels aren't loaded, so their handles are empty.
+    struct PbrMaterial
+    {
+        TextureRegistry::Handle albedo, normal, metallic, roughness, ao, orm;
+        MaterialTable::Constants constants;
+        int index; // In materialTable
+    };
+    PbrMaterial defaultMaterial, gunMaterial, targetMaterial;
+    bool packedOrmEnabled, packedOrmKeyLastFrame;
+
+    // Every material's maps in texture arrays, picked per draw by index instead of binding textures.
+    // Off by default, as the arrays hold every mip level while the separate maps are streamed.
+    MaterialTable materialTable;
+    bool materialArraysEnabled, materialArraysKeyLastFrame;
+
+    // Gamma encoding of the final pass by the framebuffer (GL_FRAMEBUFFER_SRGB) rather than pow in the shader
+    bool srgbFramebuffer; // The window's framebuffer is sRGB capable
+    bool srgbOutputEnabled, srgbOutputKeyLastFrame;
 
     // Particles texture
     GLuint particlesTexture;
@@ -87,7 +143,12 @@ private:
     void setSpotlightInnerCutoff(float degrees);
     void setSpotlightOuterCutoff(float degrees);
     void setupTextures();
-    void bindPbrTextures(GLuint albedo, GLuint normal, GLuint metallic, GLuint roughness, GLuint ao);
+    void setupStaticBatches();
+    void setupVertexPool();
+    void drawMesh(const TriangleMesh & mesh, const VertexPool::Range & range);
+    void recordPass1Time();
+    void drawTeapot();
+    void bindPbrTextures(GLSLProgram & prog, const PbrMaterial & material);
     void setupFullscreenQuad();
     void computeWeights();
     void setupSamplers();
@@ -95,13 +156,14 @@ private:
     void handleKeyboardInput(GLFWwindow* windowContext, float deltaTime);
     void handleMouseMovement(GLFWwindow* windowContext, float deltaTime);
     void handleMouseClicks(GLFWwindow* windowContext);
+    void shootBullet();
 
     void initBuffers();
     float randFloat();
     void setupParticles();
 
 public:
-    SceneBasic_Uniform();
+    explicit SceneBasic_Uniform(size_t textureBudget = 0);
 
     void initScene();
     void update( float t );
@@ -17,6 +17,7 @@ uniform float AveLum;
 uniform float Exposure;
 uniform float White;
 uniform float Gamma;
+uniform bool SrgbOutput; // GL_FRAMEBUFFER_SRGB is on, so the ROP encodes instead of pow
 
 uniform bool BloomEnabled;
 
@@ -103,8 +104,11 @@ vec4 pass5()
     // Convert back to RGB
     vec4 toneMapColor = vec4(xyz2rgb * xyzCol, 1.0);
 
-    // Gamma correct
-    toneMapColor = vec4(pow(vec3(toneMapColor), vec3(1.0 / Gamma)), 1.0);
+    // Gamma correct, unless the framebuffer encodes sRGB as it is written
+    if (!SrgbOutput)
+    {
+        toneMapColor = vec4(pow(vec3(toneMapColor), vec3(1.0 / Gamma)), 1.0);
+    }
 
     return toneMapColor;
 }
@@ -1,5 +1,8 @@
 #version 460
 
+// Fragments hidden behind others don't run, so don't report mip feedback
+layout (early_fragment_tests) in;
+
 in vec2 TexCoord;
 in vec3 Position;
 
@@ -16,6 +19,50 @@ layout (binding = 5) uniform sampler2D MetalTexture;
 layout (binding = 6) uniform sampler2D RoughnessTexture;
 layout (binding = 7) uniform sampler2D AOTexture;
 
+// Occlusion, roughness and metallic packed into R, G and B, bound in place of the separate maps
+layout (binding = 5) uniform sampler2D OrmTexture;
+uniform bool PackedOrm;
+
+// Channels a material has a constant value for, whose maps aren't sampled (see MaterialTable::Constants)
+const uint CONSTANT_ALBEDO = 1u;
+const uint CONSTANT_NORMAL = 2u; // Flat
+const uint CONSTANT_AO = 4u;
+const uint CONSTANT_ROUGHNESS = 8u;
+const uint CONSTANT_METALLIC = 16u;
+const uint CONSTANT_ORM = CONSTANT_AO | CONSTANT_ROUGHNESS | CONSTANT_METALLIC;
+
+// The bound material's constants, when not using MaterialArrays
+uniform uint ConstantChannels;
+uniform vec3 ConstantAlbedo;
+uniform vec3 ConstantOrm;
+
+// Every material's maps as texture array layers, found through MaterialIndex when MaterialArrays is set (see MaterialTable)
+struct MaterialInfo
+{
+    ivec2 Albedo; // Array and layer, array -1 if the map failed to load or is constant
+    ivec2 Normal;
+    ivec2 Orm;
+    vec4 ConstantAlbedo;
+    vec3 ConstantOrm;
+    uint ConstantChannels;
+};
+
+layout (std430, binding = 2) readonly buffer MaterialBuffer
+{
+    MaterialInfo Materials[];
+};
+
+layout (binding = 9) uniform sampler2DArray MaterialMaps[9];
+uniform bool MaterialArrays;
+uniform int MaterialIndex; // Also the material's mip feedback slot
+
+// Smallest texel footprint each material is drawn with, read back by MipStreamer to pick the
+// mip levels its separate textures need
+layout (std430, binding = 3) buffer MipFeedback
+{
+    uint MipRequests[];
+};
+
 layout (binding = 0) uniform sampler2D HdrTex;
 //layout (binding = 1) uniform sampler2D BlurTex1;
 //layout (binding = 2) uniform sampler2D BlurTex2;
@@ -36,8 +83,6 @@ uniform struct FogInfo
     vec3 Colour;
 } Fog;
 
-uniform float Gamma;
-
 uniform vec4 CameraPos;
 
 const float PI = 3.14159265358979323846;
@@ -63,7 +108,7 @@ vec3 fresnelSchlick(float dotProd, vec3 f0) // Fresnel reflection equation for s
     return f0 + (1 - f0) * pow(1.0 - dotProd, 5);
 }
 
-vec3 microfacetModel(vec3 position, vec3 n) // Reflectance Equation
+vec3 microfacetModel(vec3 position, vec3 n, vec3 albedo, float roughness, float metalness) // Reflectance Equation
 { 
     // lights in reflectance
     vec3 l = vec3(0.0); // Direction towards light
@@ -86,14 +131,11 @@ vec3 microfacetModel(vec3 position, vec3 n) // Reflectance Equation
         lightIntensity /= (dist * dist); // attenuation
     }
 
-    // Get metalness and albedo for f0
+    // Get f0 from metalness and albedo
     vec3 f0 = vec3(0.04);
-    float metalness = texture(MetalTexture, TexCoord).r;
-    vec3 albedo = pow(texture(AlbedoTexture, TexCoord).rgb, vec3(Gamma)); // convert to linear space as albedo is authored in sRGB space
     f0 = mix(f0, albedo.rgb, metalness);
 
     // Get values for BRDF
-    float roughness = texture(RoughnessTexture, TexCoord).r; // RGB values are the same as they are greyscale, so only one value needed
     vec3 v = normalize(TangentCameraPos - position);
     vec3 h = normalize(v + l);
     float nDotH = max(dot(n, h), 0.0); // Ensure valid values
@@ -120,18 +162,84 @@ vec3 microfacetModel(vec3 position, vec3 n) // Reflectance Equation
     return (diffuse + specular) * lightIntensity * nDotL;
 }
 
+// MaterialIndex is the same for the whole draw, so the sampler array index is dynamically uniform
+vec4 sampleMaterialMap(ivec2 map)
+{
+    if (map.x < 0) return vec4(0.0); // Black, like a texture that failed to load
+    return texture(MaterialMaps[map.x], vec3(TexCoord, map.y));
+}
+
+// A packed ORM sample, with the channels that are constant replaced
+vec3 withOrmConstants(vec3 orm, vec3 constantOrm, uint channels)
+{
+    bvec3 constant = bvec3(channels & CONSTANT_AO, channels & CONSTANT_ROUGHNESS, channels & CONSTANT_METALLIC);
+    return mix(orm, constantOrm, constant);
+}
+
+// Report how finely the material's maps are sampled here, as log2 of the larger UV derivative.
+// Sampling one fragment in 64, and only writing improvements, keeps the atomics cheap.
+void writeMipFeedback()
+{
+    vec2 dx = dFdx(TexCoord);
+    vec2 dy = dFdy(TexCoord);
+    if (any(notEqual(ivec2(gl_FragCoord.xy) & 7, ivec2(0)))) return;
+
+    float footprint = 0.5 * log2(max(max(dot(dx, dx), dot(dy, dy)), 1e-18));
+    uint request = uint(clamp((footprint + 32.0) * 8.0, 0.0, 512.0));
+    if (request < MipRequests[MaterialIndex]) atomicMin(MipRequests[MaterialIndex], request);
+}
+
 // Pass 1 applies normal mapping, PBR for a flashlight, and fog colouring
 vec4 pass1()
 {
+    // Sample the material once, for both the BRDF and ambient. Constant channels start with
+    // their values and skip the fetch. The flags are the same for the whole draw.
+    uint constants;
+    vec3 albedo; // Already linear, decoded by the sRGB texture formats
+    vec2 normalSample = vec2(0.5); // Flat unless sampled
+    vec3 orm; // Occlusion, roughness, metallic
+    if (MaterialArrays)
+    {
+        MaterialInfo material = Materials[MaterialIndex];
+        constants = material.ConstantChannels;
+        albedo = material.ConstantAlbedo.rgb;
+        orm = material.ConstantOrm;
+        if ((constants & CONSTANT_ALBEDO) == 0u) albedo = sampleMaterialMap(material.Albedo).rgb;
+        if ((constants & CONSTANT_NORMAL) == 0u) normalSample = sampleMaterialMap(material.Normal).rg;
+        if ((constants & CONSTANT_ORM) != CONSTANT_ORM) orm = withOrmConstants(sampleMaterialMap(material.Orm).rgb, orm, constants);
+    }
+    else
+    {
+        writeMipFeedback();
+        constants = ConstantChannels;
+        albedo = ConstantAlbedo;
+        orm = ConstantOrm;
+        if ((constants & CONSTANT_ALBEDO) == 0u) albedo = texture(AlbedoTexture, TexCoord).rgb;
+        if ((constants & CONSTANT_NORMAL) == 0u) normalSample = texture(NormalTexture, TexCoord).rg;
+        if (PackedOrm)
+        {
+            if ((constants & CONSTANT_ORM) != CONSTANT_ORM) orm = withOrmConstants(texture(OrmTexture, TexCoord).rgb, orm, constants);
+        }
+        else
+        {
+            // Single channel (BC4) maps
+            if ((constants & CONSTANT_AO) == 0u) orm.r = texture(AOTexture, TexCoord).r;
+            if ((constants & CONSTANT_ROUGHNESS) == 0u) orm.g = texture(RoughnessTexture, TexCoord).r;
+            if ((constants & CONSTANT_METALLIC) == 0u) orm.b = texture(MetalTexture, TexCoord).r;
+        }
+    }
+
     // Calculate normal direction from normal map texture. Already in tangent space, so no conversion
-    vec3 norm = texture(NormalTexture, TexCoord).xyz;
-    norm.xy = 2.0f * norm.xy - 1.0f;
+    // Only X and Y are stored (BC5), so Z is rebuilt from the unit length
+    vec3 norm;
+    norm.xy = 2.0f * normalSample - 1.0f;
+    norm.z = sqrt(max(1.0f - dot(norm.xy, norm.xy), 0.0f));
     norm = (gl_FrontFacing) ? normalize(norm) : normalize(-norm);
 
     // Calculate PBR colour
     vec3 Colour = vec3(0.0f, 0.0f, 0.0f);
-    Colour += microfacetModel(TangentFragPos, norm);
-    vec3 ambient = vec3(0.03) * texture(AlbedoTexture, TexCoord).rgb * texture(AOTexture, TexCoord).rgb;
+    Colour += microfacetModel(TangentFragPos, norm, albedo, orm.g, orm.b);
+    vec3 ambient = vec3(0.03) * albedo * orm.r;
     Colour += ambient;
 
     // Calculate Fog colour
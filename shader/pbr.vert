@@ -27,16 +27,86 @@ uniform struct SpotLightInfo
 
 uniform mat4 ModelViewMatrix;
 uniform mat3 NormalMatrix;
-uniform mat4 MVP;
+uniform mat4 ProjectionMatrix;
+uniform mat4 ViewMatrix;
+
+// Per-instance transforms, used instead of ModelViewMatrix/NormalMatrix when Instanced is set
+struct InstanceData
+{
+    mat4 ModelMatrix;
+    mat4 NormalMatrix;
+};
+
+layout (std430, binding = 0) readonly buffer InstanceBuffer
+{
+    InstanceData Instances[];
+};
+
+uniform bool Instanced;
+
+// Packed vertices, fetched with gl_VertexID instead of the attributes above when VertexPulling is set.
+// See VertexPool for the layout.
+struct PulledVertex
+{
+    float Px, Py, Pz;
+    float S, T;
+    uint Normal;
+    uint Tangent;
+    uint Pad;
+};
+
+layout (std430, binding = 1) readonly buffer VertexBuffer
+{
+    PulledVertex Vertices[];
+};
+
+uniform bool VertexPulling;
+
+// Unpack 10:10:10:2 snorm fields
+vec4 unpackSnorm1010102(uint bits)
+{
+    int p = int(bits);
+    return vec4(
+        max(float(bitfieldExtract(p, 0, 10)) / 511.0, -1.0),
+        max(float(bitfieldExtract(p, 10, 10)) / 511.0, -1.0),
+        max(float(bitfieldExtract(p, 20, 10)) / 511.0, -1.0),
+        max(float(bitfieldExtract(p, 30, 2)), -1.0)
+    );
+}
 
 uniform vec4 CameraPos;
 
 void main()
 {
+    vec3 vertexPosition = VertexPosition;
+    vec3 vertexNormal = VertexNormal;
+    vec2 vertexTexCoord = VertexTexCoord;
+    vec4 vertexTangent = VertexTangent;
+    if (VertexPulling)
+    {
+        // gl_VertexID already includes the draw's base vertex
+        PulledVertex v = Vertices[gl_VertexID];
+        vertexPosition = vec3(v.Px, v.Py, v.Pz);
+        vertexNormal = unpackSnorm1010102(v.Normal).xyz;
+        vertexTexCoord = vec2(v.S, v.T);
+        vertexTangent = unpackSnorm1010102(v.Tangent);
+    }
+
+    mat4 modelView = ModelViewMatrix;
+    mat3 normalMatrix = NormalMatrix;
+    if (Instanced)
+    {
+        // View matrix is rigid, so its upper 3x3 can be applied directly to the model normal matrix
+        InstanceData instance = Instances[gl_InstanceID];
+        modelView = ViewMatrix * instance.ModelMatrix;
+        normalMatrix = mat3(ViewMatrix) * mat3(instance.NormalMatrix);
+    }
+
     // Transform normal and tangent to view/camera/eye space
-    vec3 normal = normalize(NormalMatrix * VertexNormal);
-    vec3 tangent = normalize(NormalMatrix * vec3(VertexTangent));
-    vec3 binormal = normalize(cross(normal, tangent));
+    vec3 normal = normalize(normalMatrix * vertexNormal);
+    vec3 tangent = normalize(normalMatrix * vec3(vertexTangent));
+    // Tangent w is the handedness of the UV mapping, negated where a mirrored batch flipped it
+    vec3 binormal = normalize(cross(normal, tangent)) * vertexTangent.w;
 
     // Set matrix for transformation from view space to tangent space
     mat3 TBN = transpose(mat3(tangent, binormal, normal));
@@ -45,7 +115,7 @@ void main()
     TangentCameraPos = TBN * CameraPos.xyz;
 
     // Get fragment position in view space and tangent space
-    Position = (ModelViewMatrix * vec4(VertexPosition, 1.0f)).xyz;
+    Position = (modelView * vec4(vertexPosition, 1.0f)).xyz;
     TangentFragPos = TBN * Position;
 
     // Set spotlight positions in tangent space
@@ -53,6 +123,6 @@ void main()
     TangentSpotlightDir = TBN * Spotlight.Direction;
 
     // Set TexCoord and gl_Position for next stage in pipeline (fragment shader)
-    TexCoord = VertexTexCoord;
-    gl_Position = MVP * vec4(VertexPosition,1.0);
+    TexCoord = vertexTexCoord;
+    gl_Position = ProjectionMatrix * vec4(Position, 1.0);
 }
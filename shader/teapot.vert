@@ -0,0 +1,11 @@
+#version 460
+
+// Bezier control points, 16 per patch. They are transformed in the evaluation shader.
+layout (location = 0) in vec3 VertexPosition;
+
+out vec3 ControlPos;
+
+void main()
+{
+    ControlPos = VertexPosition;
+}